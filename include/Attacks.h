@@ -0,0 +1,93 @@
+#pragma once
+
+#include "BasicTypes.h"
+
+namespace GGChess
+{
+	// fancy magic entry of a sliding piece on one square
+	struct Magic
+	{
+		uint64_t mask; // relevant occupancy, board edges excluded
+		uint64_t magic;
+		BitBoard* attacks; // points into the shared attack table
+		uint8_t shift;
+
+		inline size_t index(uint64_t occupied) const {
+			return size_t(((occupied & mask) * magic) >> shift);
+		}
+	};
+
+	class Attacks
+	{
+	public:
+		Attacks() = delete;
+
+		static void init();
+
+		static inline BitBoard Knight(Square square) {
+			return knight[square];
+		}
+
+		static inline BitBoard King(Square square) {
+			return king[square];
+		}
+
+		// squares attacked by a pawn of the given side standing on square
+		static inline BitBoard Pawn(Square square, Side side) {
+			return pawn[sideidx(side)][square];
+		}
+
+		static inline BitBoard Bishop(Square square, BitBoard occupied) {
+			const Magic& m = bishopMagics[square];
+			return m.attacks[m.index(occupied.bits)];
+		}
+
+		static inline BitBoard Rook(Square square, BitBoard occupied) {
+			const Magic& m = rookMagics[square];
+			return m.attacks[m.index(occupied.bits)];
+		}
+
+		static inline BitBoard Queen(Square square, BitBoard occupied) {
+			return Bishop(square, occupied) | Rook(square, occupied);
+		}
+
+		// attacks of any piece type except pawns
+		static inline BitBoard Of(PieceType piece, Square square, BitBoard occupied) {
+			switch (piece) {
+			case PieceType::King: return King(square);
+			case PieceType::Queen: return Queen(square, occupied);
+			case PieceType::Bishop: return Bishop(square, occupied);
+			case PieceType::Knight: return Knight(square);
+			case PieceType::Rook: return Rook(square, occupied);
+			default: return BitBoard();
+			}
+		}
+
+		// squares strictly between two aligned squares, empty if not aligned
+		static inline BitBoard Between(Square sq1, Square sq2) {
+			return between[sq1][sq2];
+		}
+
+		// the whole line going through two aligned squares, empty if not aligned
+		static inline BitBoard Line(Square sq1, Square sq2) {
+			return line[sq1][sq2];
+		}
+	private:
+		static bool initFlag;
+
+		static BitBoard knight[BOARD_SQUARE_COUNT];
+		static BitBoard king[BOARD_SQUARE_COUNT];
+		static BitBoard pawn[2][BOARD_SQUARE_COUNT];
+
+		static BitBoard between[BOARD_SQUARE_COUNT][BOARD_SQUARE_COUNT];
+		static BitBoard line[BOARD_SQUARE_COUNT][BOARD_SQUARE_COUNT];
+
+		static Magic bishopMagics[BOARD_SQUARE_COUNT];
+		static Magic rookMagics[BOARD_SQUARE_COUNT];
+
+		static BitBoard bishopTable[0x1480];
+		static BitBoard rookTable[0x19000];
+
+		static void initMagics(PieceType piece, Magic magics[], BitBoard table[]);
+	};
+}
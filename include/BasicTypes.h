@@ -12,7 +12,8 @@ namespace GGChess
 
     static const size_t MAX_MOVES = 256;
     static const size_t MAX_DEPTH = 128;
-    static const size_t TABLE_SIZE = 1048576;
+    static const size_t MAX_THREADS = 256;
+    static const size_t KEY_HISTORY_SIZE = 1024; // game plies remembered for repetition checks
 
     enum class Side : uint8_t
     {
@@ -25,6 +26,7 @@ namespace GGChess
 
     inline Side otherside(Side side);
     inline Side operator ^ (Side lhs, Side rhs);
+    inline size_t sideidx(Side side); // 0 white, 1 black
     
     enum class PieceType : uint8_t
     {
@@ -47,7 +49,7 @@ namespace GGChess
         BKing = 17, BQueen = 18, BBishop = 19, BKnight = 20, BRook = 21, BPawn = 22
     };
 
-    inline Piece operator | (PieceType piece_t, Side side);
+    constexpr Piece operator | (PieceType piece_t, Side side);
     inline PieceType pieceof(Piece piece);
     inline Side sideof(Piece piece);
 
@@ -76,6 +78,7 @@ namespace GGChess
     inline int8_t fileof(Square square);
 
     inline bool isnear(Square sq1, Square sq2);
+    inline uint64_t bitof(Square square);
 
     inline Square operator + (Square square, int8_t delta);
     inline Square operator - (Square square, int8_t delta);
@@ -115,41 +118,79 @@ namespace GGChess
 
     inline CastleFlag& operator |= (CastleFlag& lhs, CastleFlag rhs);
     inline CastleFlag operator | (CastleFlag& lhs, CastleFlag rhs);
+
+    // compile time constants of a side, for code instantiated once per side
+    template<Side Us>
+    struct SideTraits
+    {
+        static constexpr bool IsWhite = Us == Side::White;
+
+        static constexpr Side Them = IsWhite ? Side::Black : Side::White;
+        static constexpr Value Sign = IsWhite ? 1 : -1; // white relative scores
+
+        static constexpr SDir Up = IsWhite ? SDir::N : SDir::S;
+        static constexpr SDir Down = IsWhite ? SDir::S : SDir::N;
+
+        static constexpr int8_t PawnRank = IsWhite ? 1 : 6; // where pawns may double push
+        static constexpr int8_t PromoteRank = IsWhite ? 6 : 1; // pawns promote from here
+
+        static constexpr CastleFlag Kingside = IsWhite ? CastleFlag::WhiteKingside : CastleFlag::BlackKingside;
+        static constexpr CastleFlag Queenside = IsWhite ? CastleFlag::WhiteQueenside : CastleFlag::BlackQueenside;
+        static constexpr CastleFlag Castle = IsWhite ? CastleFlag::WhiteCastle : CastleFlag::BlackCastle;
+
+        static constexpr Square KingsideRook = IsWhite ? Square::h1 : Square::h8;
+        static constexpr Square QueensideRook = IsWhite ? Square::a1 : Square::a8;
+    };
     
     class Board;
 
-    // representing a move
-    struct Move
+    // representing a move packed into 16 bits: origin (6), target (6), special code (4)
+    // the captured piece is not stored, it is read from the board when the move is played
+    class Move
     {
+    public:
         enum Flags : uint8_t {
             Basic       = 0,
-            EnPassant   = 0b0000001,
-            Castle      = 0b0000010,
-            DoublePush  = 0b0000100,
-            PromoteQ    = 0b0001000,
-            PromoteR    = 0b0010000,
-            PromoteN    = 0b0100000,
-            PromoteB    = 0b1000000,
-
-            Promotion   = 0b1111000 // All promotion flags set to test if move is a promotion
+            DoublePush  = 1,
+            Castle      = 2,
+            EnPassant   = 3,
+            PromoteN    = 4,
+            PromoteB    = 5,
+            PromoteR    = 6,
+            PromoteQ    = 7,
+
+            Promotion   = 0b0100 // Set in every promotion code
         };
 
-        Square origin;
-        Square target;
-        Piece captured; // the piece that was originally on the target square, if e.p. then Empty
-        Flags flags;
-        
-        Move() :
-            origin(Square::InvalidSquare), target(Square::InvalidSquare), captured(Piece::Empty), flags(Flags::Basic)
-        {}
+        Move() : data(0) {}
 
-        Move(Square origin, Square target, Piece captured = Piece::Empty, Flags flags = Flags::Basic) :
-            origin(origin), target(target), captured(captured), flags(flags)
+        Move(Square origin, Square target, Flags flags = Flags::Basic) :
+            data(uint16_t(origin | (target << 6) | (flags << 12)))
         {}
 
-        Move(Square origin, Square target, Flags flags) :
-            origin(origin), target(target), captured(Piece::Empty), flags(flags)
-        {}
+        explicit Move(uint16_t raw) : data(raw) {}
+
+        inline Square origin() const { return Square(data & 0x3F); }
+        inline Square target() const { return Square((data >> 6) & 0x3F); }
+        inline Flags flags() const { return Flags(data >> 12); }
+
+        inline bool isPromotion() const { return flags() & Flags::Promotion; }
+        inline PieceType promotion() const; // PieceType::None if not a promotion
+
+        inline uint16_t raw() const { return data; }
+
+        // Move() is a1a1, which is never a real move
+        inline explicit operator bool () const { return data; }
+
+        bool operator == (const Move& other) const {
+            return data == other.data;
+        }
+
+        bool operator != (const Move& other) const {
+            return data != other.data;
+        }
+    private:
+        uint16_t data;
     };
 
     static const uint64_t
@@ -158,6 +199,19 @@ namespace GGChess
 
     struct BitBoard
     {
+        // visits the set squares from a1 towards h8
+        class Iterator
+        {
+        public:
+            inline Iterator(uint64_t bits);
+
+            inline Square operator * () const;
+            inline Iterator& operator ++ ();
+            inline bool operator != (const Iterator& other) const;
+        private:
+            uint64_t bits;
+        };
+
         uint64_t bits;
 
         BitBoard() : bits(0) {}
@@ -169,10 +223,26 @@ namespace GGChess
         inline long long Get(uint64_t mask) const;
         inline bool Get(Square square) const;
 
+        inline int popcount() const;
+        inline Square lsb() const;
+        inline Square poplsb();
+        inline bool several() const;
+
+        inline Iterator begin() const;
+        inline Iterator end() const;
+
         inline BitBoard pawnAttack(Side side) const;
+        template<Side Us>
+        inline BitBoard pawnAttack() const;
+
+        inline explicit operator bool () const;
 
         inline BitBoard& operator |= (const BitBoard& other);
         inline BitBoard operator | (const BitBoard& other) const;
+        inline BitBoard& operator &= (const BitBoard& other);
+        inline BitBoard operator & (const BitBoard& other) const;
+        inline BitBoard operator ^ (const BitBoard& other) const;
+        inline BitBoard operator ~ () const;
     };
 
     struct Limits
@@ -1,6 +1,7 @@
 #include "BasicTypes.h"
 
 #include <algorithm>
+#include <bit>
 
 namespace GGChess
 {
@@ -14,9 +15,13 @@ namespace GGChess
 		return Side(int8_t(lhs) ^ uint8_t(rhs));
 	}
 
+	inline size_t sideidx(Side side) {
+		return uint8_t(side) >> 4;
+	}
+
 	// PIECE
 
-	inline Piece operator | (PieceType piece_t, Side side) {
+	constexpr Piece operator | (PieceType piece_t, Side side) {
 		return Piece(uint8_t(piece_t) | uint8_t(side));
 	}
 
@@ -45,6 +50,10 @@ namespace GGChess
 		return std::abs(rankof(sq1) - rankof(sq2)) < 2 && std::abs(fileof(sq1) - fileof(sq2)) < 2;
 	}
 
+	inline uint64_t bitof(Square square) {
+		return 1ULL << uint64_t(square);
+	}
+
 	inline bool validsquare(Square square) {
 		return int8_t(square) >= 0 && int8_t(square) < 64;
 	}
@@ -105,6 +114,18 @@ namespace GGChess
 		return CastleFlag(uint8_t(lhs) | uint8_t(rhs));
 	}
 
+	// MOVE
+
+	inline PieceType Move::promotion() const {
+		switch (flags()) {
+		case Flags::PromoteQ: return PieceType::Queen;
+		case Flags::PromoteR: return PieceType::Rook;
+		case Flags::PromoteN: return PieceType::Knight;
+		case Flags::PromoteB: return PieceType::Bishop;
+		default: return PieceType::None;
+		}
+	}
+
 	// BIT BOARD
 	/*
 	const BitBoard BitBoard::AFile = BitBoard(0x0101010101010101ULL);
@@ -129,10 +150,61 @@ namespace GGChess
 		return Get(uint64_t(1LL << uint64_t(square)));
 	}
 
+	inline int BitBoard::popcount() const {
+		return std::popcount(bits);
+	}
+
+	inline Square BitBoard::lsb() const {
+		return Square(std::countr_zero(bits));
+	}
+
+	inline Square BitBoard::poplsb() {
+		Square square = lsb();
+		bits &= bits - 1;
+		return square;
+	}
+
+	inline bool BitBoard::several() const {
+		return bits & (bits - 1);
+	}
+
+	inline BitBoard::Iterator BitBoard::begin() const {
+		return Iterator(bits);
+	}
+
+	inline BitBoard::Iterator BitBoard::end() const {
+		return Iterator(0);
+	}
+
+	inline BitBoard::Iterator::Iterator(uint64_t bits) : bits(bits) {}
+
+	inline Square BitBoard::Iterator::operator * () const {
+		return Square(std::countr_zero(bits));
+	}
+
+	inline BitBoard::Iterator& BitBoard::Iterator::operator ++ () {
+		bits &= bits - 1;
+		return *this;
+	}
+
+	inline bool BitBoard::Iterator::operator != (const Iterator& other) const {
+		return bits != other.bits;
+	}
+
 	inline BitBoard BitBoard::pawnAttack(Side side) const {
-		return side == Side::White ?
-			(bits & ~fileA) << 7 | (bits & ~fileH) << 9 :
-			(bits & ~fileA) >> 9 | (bits & ~fileH) >> 7;
+		return side == Side::White ? pawnAttack<Side::White>() : pawnAttack<Side::Black>();
+	}
+
+	template<Side Us>
+	inline BitBoard BitBoard::pawnAttack() const {
+		if constexpr (Us == Side::White)
+			return (bits & ~fileA) << 7 | (bits & ~fileH) << 9;
+		else
+			return (bits & ~fileA) >> 9 | (bits & ~fileH) >> 7;
+	}
+
+	inline BitBoard::operator bool () const {
+		return bits;
 	}
 
 	inline BitBoard& BitBoard::operator |= (const BitBoard& other) {
@@ -143,4 +215,21 @@ namespace GGChess
 	inline BitBoard BitBoard::operator | (const BitBoard& other) const {
 		return bits | other.bits;
 	}
+
+	inline BitBoard& BitBoard::operator &= (const BitBoard& other) {
+		bits &= other.bits;
+		return *this;
+	}
+
+	inline BitBoard BitBoard::operator & (const BitBoard& other) const {
+		return bits & other.bits;
+	}
+
+	inline BitBoard BitBoard::operator ^ (const BitBoard& other) const {
+		return bits ^ other.bits;
+	}
+
+	inline BitBoard BitBoard::operator ~ () const {
+		return ~bits;
+	}
 }
@@ -18,17 +18,13 @@ namespace GGChess
             doubleCheck;
 
         BitBoard
-            checkBoard,
-            attackBoard,
-            pAttackBoard[2], // idx 0 white, idx 1 black
-            unifiedPinBoard;
-
-        std::array<BitBoard, 8> pinBoards;
+            checkers,
+            checkBoard, // squares that resolve a single check: the checker and the ray towards the king
+            pinned;
 
         PosInfo() :
             check(false), doubleCheck(false),
-            checkBoard(), attackBoard(), pAttackBoard{},
-            unifiedPinBoard(), pinBoards()
+            checkers(), checkBoard(), pinned()
         {}
     };
 
@@ -37,9 +33,15 @@ namespace GGChess
     public:
         friend class Fen;
 
+        // state before a move, UnplayMove restores it instead of recomputing it
         struct MoveData {
             Move move;
+            Piece captured; // the piece that was on the target square, Empty for e.p.
             CastleFlag castle;
+            Square epTarget;
+            int halfmove;
+            ZobristKey key;
+            ZobristKey pawnKey;
         };
 
     public:
@@ -50,6 +52,11 @@ namespace GGChess
 
         void UnplayMove();
 
+        // passes the turn, for null move pruning: flips the side and clears the e.p. target
+        // the record holds Move() so the played line shows the skipped turn
+        void PlayNullMove();
+        void UnplayNullMove();
+
         const Piece& operator [] (Square square) const;
         const Piece& operator [] (size_t idx) const;
 
@@ -60,11 +67,26 @@ namespace GGChess
         Side Turn() const;
         Square King(Side side) const;
         const std::array<Piece, 64>& array() const;
+        BitBoard Occupied() const;
+        BitBoard Pieces(Side side) const;
+        BitBoard Pieces(PieceType piece) const;
+        BitBoard Pieces(PieceType piece, Side side) const;
         Square EPTarget() const;
+        Piece Captured(const Move& move) const; // includes the pawn taken e.p.
         PosInfo Info() const;
+        BitBoard Checkers() const;
+        BitBoard AttackersTo(Square square, BitBoard occupied) const;
+        BitBoard AttackMap(Side attacker) const;
         ZobristKey Key() const;
         ZobristKey PKey() const;
         CastleFlag Castling() const;
+        int HalfMove() const;
+
+        // fifty move rule or repetition, a position repeated inside the search (within ply plies)
+        // counts at once, one from before the root only when it is already the third occurrence;
+        // in check the fifty move rule is left to the caller, a mate on the last move still wins
+        bool IsDraw(int ply) const;
+        bool HasNonPawnMaterial(Side side) const;
 
         bool CanCastle(CastleFlag flag) const;
 
@@ -72,6 +94,10 @@ namespace GGChess
     private:
         std::array<Piece, BOARD_SQUARE_COUNT> board;
 
+        BitBoard occupied;
+        BitBoard sidePieces[2]; // idx 0 white, idx 1 black
+        BitBoard typePieces[PIECE_COUNT]; // indexed by PieceType
+
         ZobristHash hash;
         ZobristHash phash;
 
@@ -80,18 +106,30 @@ namespace GGChess
 
         Side turn;
 
-        Square ep_start;
         Square ep_target;
 
         CastleFlag castling;
 
+        int halfmove; // plies since the last capture or pawn move
         int ply;
     public:
         FastArray<MoveData, MAX_DEPTH> moveRecord;
     private:
+        FastArray<ZobristKey, KEY_HISTORY_SIZE> keyHistory; // keys of the positions before each move
+
         void PlacePiece(Square square, Piece piece);
         void RemovePiece(Square square);
 
+        template<Side Us>
+        void PlayUnrecorded(const Move& move);
+
         void MovePiece(Square origin, Square target);
+
+        // drops the keys older than the last irreversible move, they cannot repeat
+        void TrimKeyHistory();
+
+        // no hashing and no checks, for restoring a recorded state
+        void SetPiece(Square square, Piece piece);
+        void ClearPiece(Square square);
     };
 }
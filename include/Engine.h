@@ -0,0 +1,50 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "BasicTypes.h"
+#include "Board.h"
+
+namespace GGChess
+{
+	struct SearchContext;
+	class ThreadPool;
+
+	// one analysis: its position, search threads and stop flag, only the transposition table
+	// is shared, so independent engines can search different positions in the same process
+	class Engine
+	{
+	public:
+		Engine();
+		~Engine();
+
+		Engine(const Engine&) = delete;
+		Engine& operator = (const Engine&) = delete;
+
+		Board& Position();
+
+		// resets the position and forgets the move ordering statistics, the shared tables are
+		// only emptied when no other engine exists that could be using them
+		void NewGame();
+
+		// searches the position with every thread (Lazy SMP) and returns the main thread's move
+		Move Search(const Limits& limits);
+
+		void SetThreads(size_t count);
+		size_t Threads() const;
+
+		bool Stopped() const;
+
+		// nodes searched by all threads in the current search
+		uint64_t Nodes() const;
+	private:
+		Board position;
+
+		std::vector<std::unique_ptr<SearchContext>> contexts; // main thread first
+		std::unique_ptr<ThreadPool> helpers; // runs every context but the main one
+
+		std::atomic_bool stop;
+	};
+}
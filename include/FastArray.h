@@ -1,37 +1,40 @@
 #pragma once
 
+#include <algorithm>
 #include <stdexcept>
 
+// fixed capacity array living in place, so creating one per node costs no allocation
 template<typename Type, size_t max_size>
 class FastArray
 {
 public:
 	FastArray() :
-		items((Type*)malloc(sizeof(Type) * max_size)), last(items), count(0)
+		count(0)
 	{}
 
-	FastArray& operator = (const FastArray& other) {
-		for (size_t i = 0; i < max_size; i++) {
-			items[i] = other.items[i];
-		}
-		return *this;
+	// only the used part is copied, a copied board does not pay for the whole capacity
+	FastArray(const FastArray& other) :
+		count(other.count)
+	{
+		std::copy(other.items, other.items + count, items);
 	}
 
-	~FastArray() {
-		free(items);
+	FastArray& operator = (const FastArray& other) {
+		count = other.count;
+		std::copy(other.items, other.items + count, items);
+		return *this;
 	}
 
-	size_t size() {
+	size_t size() const {
 		return count;
 	}
 
-	size_t capacity() {
+	size_t capacity() const {
 		return max_size;
 	}
 
 	void clear() {
 		count = 0;
-		last = items;
 	}
 
 	Type* begin() {
@@ -39,34 +42,35 @@ public:
 	}
 
 	Type* end() {
-		return last;
+		return items + count;
 	}
 
 	void push_back(const Type& item) {
 		if (count == max_size)
 			throw std::out_of_range("Fast array full");
 
-		count++;
-		*last++ = item;
+		items[count++] = item;
 	}
 
 	Type pop_back() {
 		if (!count)
 			throw std::out_of_range("Fast array empty");
 
-		count--;
-		return *--last;
+		return items[--count];
 	}
 
 	Type& back() {
-		return *(last - 1);
+		return items[count - 1];
 	}
 
 	Type& operator [] (size_t idx) {
 		return items[idx];
 	}
+
+	const Type& operator [] (size_t idx) const {
+		return items[idx];
+	}
 private:
-	Type* items;
-	Type* last;
+	Type items[max_size];
 	size_t count;
 };
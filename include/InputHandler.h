@@ -11,10 +11,10 @@
 
 namespace GGChess
 {
-	struct SearchData;
+	struct SearchContext;
 	struct RootMove;
 
 	void UCIMain();
 
-	void printSearchData(SearchData& sdata, bool forced = false);
+	void printSearchData(SearchContext& ctx, bool forced = false);
 }
@@ -22,13 +22,29 @@ namespace GGChess
 
 	typedef FastArray<Move, MAX_MOVES> MoveList;
 
+	enum class GenType {
+		All,
+		Captures, // captures, en passant and promotions
+		Quiets // everything else
+	};
+
 	void GetAllMoves(Board& board, const PosInfo& info, MoveList& moves);
 
 	void GetAllCaptures(Board& board, const PosInfo& info, MoveList& moves);
 
-	void GetMoves(Board& board, const PosInfo& info, Square square, MoveList& moves);
+	void GetAllQuiets(Board& board, const PosInfo& info, MoveList& moves);
+
+	void GetMoves(Board& board, const PosInfo& info, Square square, MoveList& moves, GenType type = GenType::All);
+
+	// moves that may leave the own king in check, they have to pass IsLegal before being played
+	void GetPseudoMoves(Board& board, const PosInfo& info, MoveList& moves, GenType type);
+
+	bool IsLegal(Board& board, const PosInfo& info, const Move& move);
+
+	// checks a move coming from another position (hash move, killer)
+	bool IsPseudoLegal(Board& board, const PosInfo& info, const Move& move);
 
-	bool IsSquareAttacked(Board& board, const PosInfo& info, Square square, Side attacker);
+	bool IsSquareAttacked(Board& board, Square square, Side attacker);
 
-	size_t Perft(size_t depth, Board& board);
+	bool IsSquareAttacked(Board& board, Square square, Side attacker, BitBoard occupied);
 }
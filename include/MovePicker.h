@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdlib>
+
+#include "BasicTypes.h"
+#include "Board.h"
+#include "MoveGenerator.h"
+
+namespace GGChess
+{
+	// history scores stay within (-MAX_HISTORY, MAX_HISTORY)
+	const int MAX_HISTORY = 16384;
+
+	// pieces of both sides in one index, for the tables below
+	const size_t PIECE_INDEX_COUNT = 2 * PIECE_COUNT;
+
+	inline size_t PieceIndex(Piece piece) {
+		return (uint8_t(piece) >> 4) * PIECE_COUNT + uint8_t(pieceof(piece));
+	}
+
+	typedef int16_t PieceToHistory[PIECE_INDEX_COUNT][BOARD_SQUARE_COUNT];
+
+	// move ordering statistics of one search thread, learnt from beta cutoffs
+	struct MoveHistory
+	{
+		int16_t butterfly[2][BOARD_SQUARE_COUNT][BOARD_SQUARE_COUNT]; // [side][origin][target] of quiet moves
+		PieceToHistory continuation[PIECE_INDEX_COUNT][BOARD_SQUARE_COUNT]; // quiet moves after the move of a piece to a square
+		int16_t captures[PIECE_INDEX_COUNT][BOARD_SQUARE_COUNT][PIECE_COUNT]; // [piece][target][captured type]
+		Move counters[PIECE_INDEX_COUNT][BOARD_SQUARE_COUNT]; // quiet refutation of the move of a piece to a square
+
+		void clear();
+
+		// butterfly and continuation scores of a quiet move, continuation entries may be null
+		int quietScore(Side side, Piece piece, const Move& move, const PieceToHistory* const continuation[2]) const;
+	};
+
+	// gravity update: the bonus shrinks as the entry approaches the limit, so scores saturate
+	inline void UpdateHistory(int16_t& entry, int bonus) {
+		entry += bonus - entry * std::abs(bonus) / MAX_HISTORY;
+	}
+
+	// hands out the pseudo legal moves of a node one by one, generating them stage by stage
+	// so that a cutoff on an early move saves the rest of the work
+	class MovePicker
+	{
+	public:
+		// main search: hash move, good captures, killers, countermove, quiets by history, bad captures
+		// continuation holds the tables of the moves one and two plies back, null when there is none
+		MovePicker(Board& board, const Move& ttMove, const Move killers[2], const Move& counter,
+			const MoveHistory& history, const PieceToHistory* const continuation[2]);
+
+		// quiescence search: captures only, best first
+		MovePicker(Board& board);
+
+		// returns Move() when there are no more moves
+		Move next();
+
+		const PosInfo& Info() const;
+	private:
+		enum class Stage {
+			TTMove, GenCaptures, GoodCaptures, Killers, CounterMove, GenQuiets, Quiets, BadCaptures,
+			QGenCaptures, QCaptures,
+			Done
+		};
+
+		Board& board;
+		PosInfo info;
+		Stage stage;
+
+		Move ttMove;
+		Move killers[2];
+		size_t killerIdx;
+		Move counter;
+
+		const MoveHistory* history;
+		const PieceToHistory* continuation[2];
+
+		MoveList moves;
+		MoveList badCaptures;
+		Value scores[MAX_MOVES];
+		size_t current;
+
+		void scoreCaptures();
+		void scoreQuiets();
+		Move pickBest();
+	};
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "BasicTypes.h"
+#include "ZobristHash.h"
+
+namespace GGChess
+{
+	class Board;
+
+	// leaf counts of already visited (position, depth) pairs, shared by the perft threads
+	class PerftTable
+	{
+	public:
+		PerftTable(size_t sizeMB);
+
+		bool probe(ZobristKey key, size_t depth, uint64_t& nodes) const;
+		void save(ZobristKey key, size_t depth, uint64_t nodes);
+	private:
+		// check is key ^ data, so an entry torn by a concurrent write fails the probe
+		struct Entry {
+			std::atomic<uint64_t> check;
+			std::atomic<uint64_t> data; // nodes << 8 | depth
+		};
+
+		std::unique_ptr<Entry[]> table;
+		size_t mask;
+	};
+
+	struct PerftSettings
+	{
+		size_t threads;
+		size_t hashMB; // 0 disables the table
+		bool copyMake; // copy-make instead of make-unmake, for comparison
+
+		PerftSettings();
+	};
+
+	struct PerftResult
+	{
+		Move move;
+		uint64_t nodes;
+	};
+
+	// counts the leaves at depth, depth 1 is counted from the move list without playing
+	uint64_t Perft(size_t depth, Board& board);
+
+	uint64_t Perft(size_t depth, Board& board, PerftTable* table);
+
+	// copy-make variant of Perft, every child position is a copy of its parent
+	uint64_t PerftCopy(size_t depth, Board& board);
+
+	// leaf count of every root move, the root moves are split across a thread pool
+	std::vector<PerftResult> PerftDivide(size_t depth, Board& board, const PerftSettings& settings);
+
+	// runs the standard test positions against their known leaf counts, deepest depth capped
+	// at maxDepth (0 means each position's own), prints every count and nps, returns false on any mismatch
+	bool PerftSuite(size_t maxDepth, const PerftSettings& settings);
+}
@@ -3,14 +3,17 @@
 #include "BasicTypes.h"
 
 #include <array>
+#include <atomic>
 #include <chrono>
 
 #include "FastArray.h"
 #include "BasicTypes.h"
+#include "Board.h"
+#include "MovePicker.h"
 
 namespace GGChess
 {
-	class Board;
+	class Engine;
 	struct PosInfo;
 
 	extern const Value MAX_VALUE, MIN_VALUE;
@@ -31,9 +34,11 @@ namespace GGChess
 	struct SearchData {
 		using clock = typename std::chrono::steady_clock;
 
-		uint64_t nodes;
-		uint64_t qnodes;
-		uint64_t aspf;
+		// only written by the owning thread, atomic so that the main thread can sum them up
+		std::atomic<uint64_t> nodes;
+		std::atomic<uint64_t> qnodes;
+		uint64_t aspf; // aspiration searches that failed low or high
+		Value windowAlpha, windowBeta; // window of the last root search
 
 		Timer timer;
 		uint64_t movetime;
@@ -41,13 +46,47 @@ namespace GGChess
 		Side side;
 		size_t depth;
 		RootMove best;
+		FastArray<Move, MAX_DEPTH> pv; // line of the best root move
+
+		// last info line, the reports are throttled
+		size_t reportDepth;
+		Timer reportTimer;
 
 		void reset();
 		void allocTime(Limits limits, Board& board);
-		bool timeout();
 	};
 
-	extern SearchData sdata;
+	// everything one search thread works with, only the transposition table is shared between them
+	struct SearchContext
+	{
+		SearchContext(Engine& engine, size_t threadIdx);
+
+		Engine& engine; // owns the stop flag
+		size_t threadIdx; // 0 is the main thread, it reports and its move is played
+
+		Board board;
+		SearchData data;
+
+		MoveHistory history;
+
+		// state of each ply of the current line
+		struct StackEntry {
+			Move move; // the move played from this ply, Move() for a null move
+			Piece piece; // the piece that made it
+			Value staticEval; // MIN_VALUE when in check
+			bool improving; // the static eval is better than two plies before
+			Move killers[2]; // quiet moves that caused a beta cutoff at this ply
+			Move excluded; // skipped by the singular extension search of this ply
+			int extensions; // plies of extension on the path to this ply
+		} stack[MAX_DEPTH];
+
+		// triangular pv table, pv[ply] holds the best line found from ply, up to pvLength[ply]
+		Move pv[MAX_DEPTH][MAX_DEPTH];
+		size_t pvLength[MAX_DEPTH];
+
+		bool isMain() const;
+		bool timeout();
+	};
 
 	extern const int phaseInc[7];
 
@@ -69,9 +108,12 @@ namespace GGChess
 		extern const Value kingSafetyTable[100];
 	}
 
-	Value Evaluate(Board& board, const PosInfo& info);
+	Value Evaluate(Board& board);
 
-	Move Search(Board& board, const Limits& limits);
+	// searches ctx.board until the context times out, the result is left in ctx.data.best
+	void IterativeDeepening(SearchContext& ctx);
 
-	bool BadCapture(Board& board, Move& move);
+	// static exchange evaluation: material won by the side making the move when both sides
+	// keep recapturing on the target with their least valuable piece while it pays
+	Value SEE(const Board& board, const Move& move);
 }
@@ -9,6 +9,7 @@
 #include <future>
 #include <type_traits>
 #include <memory>
+#include <thread>
 
 #include <iostream>
 
@@ -53,21 +54,27 @@ namespace GGChess
 		TaskQueue() : c(), q(), m() {}
 
 		void push(TaskPtr task);
-		TaskPtr pop();
+		TaskPtr pop(); // blocks until there is a task, nullptr once stopped
 
+		void stop();
 	private:
 		std::condition_variable c;
 		std::queue<TaskPtr> q;
 		std::mutex m;
+		bool stopped = false;
 	};
 
 	class ThreadPool
 	{
 	public:
-		ThreadPool();
-		~ThreadPool();
+		ThreadPool(size_t threadCount = DefaultSize());
+		~ThreadPool(); // waits for the running tasks, queued ones are dropped
 
-		template<typename Func, typename ReturnType>
+		size_t size() const;
+
+		static size_t DefaultSize();
+
+		template<typename Func, typename ReturnType = std::invoke_result_t<Func>>
 		std::future<ReturnType> submit(Func f) {
 			std::shared_ptr<Task<Func, ReturnType>> taskPtr = std::make_shared<Task<Func, ReturnType>>(f);
 			if(!taskPtr)
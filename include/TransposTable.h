@@ -1,27 +1,88 @@
 #pragma once
 
+#include <atomic>
+#include <string>
+
 #include "ZobristHash.h"
+#include "BasicTypes.h"
 
 namespace GGChess
 {
-	enum class TTFlag {
+	enum class TTFlag : uint8_t {
 		Exact, Alpha, Beta
 	};
 
+	// a probed entry, key is the full key of the position when it was found and 0 otherwise
 	struct TTEntry {
 		ZobristKey key;
-		uint8_t depth;
 		Value eval;
+		Move best;
+		uint8_t depth;
 		TTFlag flag;
+	};
+
+	// one slot unpacked, stored as a single 64 bit word so that a probe running alongside a save
+	// of another thread sees either the old or the new entry, never a mix of the two
+	struct TTSlot {
+		uint16_t key; // upper 16 bits of the key, the lower ones select the cluster
 		Move best;
+		int16_t eval;
+		uint8_t depth; // 0 marks an empty slot, the search stores from depth 1
+		uint8_t genFlag; // generation in the upper 6 bits, TTFlag in the lower 2
+
+		inline TTFlag flag() const { return TTFlag(genFlag & 0x3); }
+		inline uint8_t generation() const { return genFlag & 0xFC; }
+
+		inline uint64_t pack() const {
+			return uint64_t(key) | uint64_t(best.raw()) << 16 | uint64_t(uint16_t(eval)) << 32 |
+				uint64_t(depth) << 48 | uint64_t(genFlag) << 56;
+		}
+
+		static inline TTSlot unpack(uint64_t data) {
+			return { uint16_t(data), Move(uint16_t(data >> 16)), int16_t(uint16_t(data >> 32)),
+				uint8_t(data >> 48), uint8_t(data >> 56) };
+		}
+	};
+
+	static const size_t TT_CLUSTER_SIZE = 8;
+
+	// the table memory comes zeroed from the OS and is cleared with memset, so an empty
+	// cluster is all zero bits
+	struct alignas(64) TTCluster {
+		std::atomic<uint64_t> slots[TT_CLUSTER_SIZE];
 	};
 
+	// pawn and eval cache entry, one word for the same reason as TTSlot: the key without its
+	// lower 16 bits (the index covers those) and the eval in them
 	struct SimpleTTEntry {
-		ZobristKey key;
-		Value eval;
+		std::atomic<uint64_t> data;
+	};
+
+	// default sizes in MB, the UCI options Hash, PawnHash and EvalHash change them
+	static const size_t
+		TT_DEFAULT_MB = 64,
+		PTT_DEFAULT_MB = 16,
+		ETT_DEFAULT_MB = 32,
+		MAX_HASH_MB = 1 << 20;
+
+	// bump whenever TTSlot, TTCluster or SimpleTTEntry change, older snapshots are then refused
+	static const uint32_t SNAPSHOT_VERSION = 2;
+
+	// a snapshot file is this header in its first page, then the main, pawn and eval tables,
+	// each starting on a page boundary so that a table can be mapped from the file directly
+	struct SnapshotHeader {
+		char magic[8];
+		uint32_t version;
+		uint32_t clusterSize;
+		uint32_t simpleEntrySize;
+		uint8_t generation;
+		uint64_t zobristSeed;
+		uint64_t ttBytes;
+		uint64_t pttBytes;
+		uint64_t ettBytes;
 	};
 
-	class TransposTable // TODO Pawn table
+	class TransposTable
 	{
 	public:
 		TransposTable();
@@ -29,31 +90,51 @@ namespace GGChess
 
 		~TransposTable();
 
+		// size in bytes, rounded down to a power of two clusters
 		void resize(size_t size);
 		bool probe(ZobristKey key, uint8_t depth, Value alpha, Value beta, TTEntry& entry);
 		void save(ZobristKey key, uint8_t depth, Value eval, TTFlag flag, Move best);
 		void prefetch(ZobristKey key);
 
-		
+		// ages the entries of the previous searches, they are replaced first
+		void newSearch();
+
+		// empties all three tables, split across threadCount threads
+		void clear(size_t threadCount);
+
+		// writes all three tables to a snapshot file
+		bool saveSnapshot(const std::string& path) const;
+		// replaces all three tables with the ones of a snapshot file, the sizes become those of
+		// the file; where possible the file is mapped copy-on-write and read in as it is probed
+		bool loadSnapshot(const std::string& path);
+
+		// pawn structure scores by pawn key
 		void ptt_resize(size_t size);
-		bool ptt_probe(ZobristKey key, SimpleTTEntry& entry);
+		bool ptt_probe(ZobristKey key, Value& eval);
 		void ptt_save(ZobristKey key, Value eval);
-		
+
+		// static evaluations by position key
 
 		void ett_resize(size_t size);
-		bool ett_probe(ZobristKey key, SimpleTTEntry& entry);
+		bool ett_probe(ZobristKey key, Value& eval);
 		void ett_save(ZobristKey key, Value eval);
 	private:
-		TTEntry* tt;
-		size_t tt_size;
+		TTCluster* tt;
+		size_t tt_size; // cluster count - 1
+		size_t tt_bytes;
+		uint8_t generation; // steps by 4, the lower bits of genFlag hold the flag
 
 		SimpleTTEntry* ptt;
 		size_t ptt_size;
+		size_t ptt_bytes;
 
 		SimpleTTEntry* ett;
 		size_t ett_size;
+		size_t ett_bytes;
+
+		size_t resize_tt(void** table, size_t& bytes, size_t entry_size, size_t size);
 
-		size_t resize_tt(void** table, size_t entry_size, size_t size);
+		TTCluster& cluster(ZobristKey key);
 	};
 
 	extern TransposTable tpostable;
@@ -7,6 +7,9 @@ namespace GGChess
 {
 	typedef uint64_t ZobristKey;
 
+	// seed of the key tables, stored keys (hash snapshots) are only valid under the same one
+	const uint64_t ZOBRIST_SEED = 1070372;
+
 	class Board;
 
 	class RandGen
@@ -29,6 +32,7 @@ namespace GGChess
 		void castle(CastleFlag flags);
 		void enPassant(Square square);
 		void flipSide();
+		void restore(ZobristKey key);
 
 		ZobristKey key() const;
 
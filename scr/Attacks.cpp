@@ -0,0 +1,157 @@
+#include "Attacks.h"
+
+#include <vector>
+
+#include "ZobristHash.h"
+
+namespace GGChess
+{
+	bool Attacks::initFlag = false;
+
+	BitBoard Attacks::knight[BOARD_SQUARE_COUNT];
+	BitBoard Attacks::king[BOARD_SQUARE_COUNT];
+	BitBoard Attacks::pawn[2][BOARD_SQUARE_COUNT];
+
+	BitBoard Attacks::between[BOARD_SQUARE_COUNT][BOARD_SQUARE_COUNT];
+	BitBoard Attacks::line[BOARD_SQUARE_COUNT][BOARD_SQUARE_COUNT];
+
+	Magic Attacks::bishopMagics[BOARD_SQUARE_COUNT];
+	Magic Attacks::rookMagics[BOARD_SQUARE_COUNT];
+
+	BitBoard Attacks::bishopTable[0x1480];
+	BitBoard Attacks::rookTable[0x19000];
+
+	// sets the square at (rank, file) if it is on the board
+	static void SetIfValid(BitBoard& board, int rank, int file) {
+		if (rank >= 0 && rank < 8 && file >= 0 && file < 8)
+			board.Set(Square(rank * 8 + file), true);
+	}
+
+	// attacks of a slider computed ray by ray, only used to fill the tables
+	static BitBoard SlidingAttacks(PieceType piece, Square square, uint64_t occupied)
+	{
+		static const int
+			rookDirs[4][2] = { { 1, 0 }, { 0, 1 }, { -1, 0 }, { 0, -1 } },
+			bishopDirs[4][2] = { { 1, 1 }, { -1, 1 }, { -1, -1 }, { 1, -1 } };
+
+		const int (*dirs)[2] = piece == PieceType::Rook ? rookDirs : bishopDirs;
+		BitBoard attacks;
+
+		for (int i = 0; i < 4; i++) {
+			int
+				rank = rankof(square) + dirs[i][0],
+				file = fileof(square) + dirs[i][1];
+
+			while (rank >= 0 && rank < 8 && file >= 0 && file < 8) {
+				Square target = Square(rank * 8 + file);
+				attacks.Set(target, true);
+
+				if (occupied & bitof(target))
+					break;
+
+				rank += dirs[i][0];
+				file += dirs[i][1];
+			}
+		}
+		return attacks;
+	}
+
+	void Attacks::initMagics(PieceType piece, Magic magics[], BitBoard table[])
+	{
+		// seeds known to find every magic quickly, one for each rank
+		static const uint64_t seeds[8] = { 728, 10316, 55013, 32803, 12281, 15100, 16645, 255 };
+
+		std::vector<uint64_t> occupancy(4096), reference(4096);
+		std::vector<int> epoch(4096, 0);
+		int attempt = 0;
+		size_t offset = 0;
+
+		for (int sq = 0; sq < int(BOARD_SQUARE_COUNT); sq++) {
+			Square square = Square(sq);
+			Magic& m = magics[sq];
+
+			// the edges do not matter, a slider stops on them anyway
+			uint64_t edges =
+				((0xFFULL | 0xFF00000000000000ULL) & ~(0xFFULL << (rankof(square) * 8))) |
+				((fileA | fileH) & ~(fileA << fileof(square)));
+
+			m.mask = SlidingAttacks(piece, square, 0).bits & ~edges;
+			m.shift = uint8_t(64 - std::popcount(m.mask));
+			m.attacks = table + offset;
+
+			// enumerate every subset of the mask (carry-rippler)
+			size_t size = 0;
+			uint64_t subset = 0;
+			do {
+				occupancy[size] = subset;
+				reference[size] = SlidingAttacks(piece, square, subset).bits;
+				size++;
+				subset = (subset - m.mask) & m.mask;
+			} while (subset);
+
+			// try sparse random numbers until one maps every subset without a bad collision
+			RandGen rgen(seeds[rankof(square)]);
+			for (size_t i = 0; i < size;) {
+				do {
+					m.magic = rgen.rand() & rgen.rand() & rgen.rand();
+				} while (std::popcount((m.mask * m.magic) >> 56) < 6);
+
+				attempt++;
+				for (i = 0; i < size; i++) {
+					size_t idx = m.index(occupancy[i]);
+
+					if (epoch[idx] < attempt) {
+						epoch[idx] = attempt;
+						m.attacks[idx] = reference[i];
+					}
+					else if (m.attacks[idx].bits != reference[i])
+						break;
+				}
+			}
+			offset += size;
+		}
+	}
+
+	void Attacks::init()
+	{
+		if (initFlag)
+			return;
+
+		static const int
+			knightSteps[8][2] = { { 2, 1 }, { 1, 2 }, { -1, 2 }, { -2, 1 }, { -2, -1 }, { -1, -2 }, { 1, -2 }, { 2, -1 } },
+			kingSteps[8][2] = { { 1, 0 }, { 1, 1 }, { 0, 1 }, { -1, 1 }, { -1, 0 }, { -1, -1 }, { 0, -1 }, { 1, -1 } };
+
+		for (int sq = 0; sq < int(BOARD_SQUARE_COUNT); sq++) {
+			int
+				rank = rankof(Square(sq)),
+				file = fileof(Square(sq));
+
+			for (size_t i = 0; i < 8; i++) {
+				SetIfValid(knight[sq], rank + knightSteps[i][0], file + knightSteps[i][1]);
+				SetIfValid(king[sq], rank + kingSteps[i][0], file + kingSteps[i][1]);
+			}
+
+			pawn[0][sq] = BitBoard(bitof(Square(sq))).pawnAttack(Side::White);
+			pawn[1][sq] = BitBoard(bitof(Square(sq))).pawnAttack(Side::Black);
+		}
+
+		initMagics(PieceType::Bishop, bishopMagics, bishopTable);
+		initMagics(PieceType::Rook, rookMagics, rookTable);
+
+		for (int sq1 = 0; sq1 < int(BOARD_SQUARE_COUNT); sq1++) {
+			for (int sq2 = 0; sq2 < int(BOARD_SQUARE_COUNT); sq2++) {
+				Square s1 = Square(sq1), s2 = Square(sq2);
+
+				for (PieceType piece : { PieceType::Bishop, PieceType::Rook }) {
+					if (!(Of(piece, s1, 0).bits & bitof(s2)))
+						continue;
+
+					line[sq1][sq2] = (Of(piece, s1, 0) & Of(piece, s2, 0)).bits | bitof(s1) | bitof(s2);
+					between[sq1][sq2] = Of(piece, s1, bitof(s2)) & Of(piece, s2, bitof(s1));
+				}
+			}
+		}
+
+		initFlag = true;
+	}
+}
@@ -5,20 +5,23 @@
 #include <iostream>
 #include "IO.h"
 
-#include "MovePatterns.h"
+#include "Attacks.h"
 
 namespace GGChess
 {
 	Board::Board() :
-		board{ Piece::Empty }, hash(),
+		board{ Piece::Empty },
+		occupied(), sidePieces{}, typePieces{},
+		hash(),
 		whiteKing(Square::InvalidSquare),
 		blackKing(Square::InvalidSquare),
 		turn(Side::White),
-		ep_start(Square::InvalidSquare),
 		ep_target(Square::InvalidSquare),
 		castling((CastleFlag)15),
-		ply(0), moveRecord()
+		halfmove(0), ply(0), moveRecord(), keyHistory()
 	{
+		Attacks::init();
+
 		PieceType pieces[3] = { PieceType::Rook, PieceType::Knight, PieceType::Bishop};
 		
 		for (int8_t file = 0; file < 3; file++) {
@@ -39,158 +42,177 @@ namespace GGChess
 		
 		PlacePiece(Square::d1, Piece::WQueen);
 		PlacePiece(Square::d8, Piece::BQueen);
+
+		hash.castle(castling);
+	}
+
+	void Board::PlayUnrecorded(const Move& move)
+	{
+		if (keyHistory.size() == keyHistory.capacity())
+			TrimKeyHistory();
+		keyHistory.push_back(hash.key());
+
+		if (turn == Side::White)
+			PlayUnrecorded<Side::White>(move);
+		else
+			PlayUnrecorded<Side::Black>(move);
 	}
 
+	template<Side Us>
 	void Board::PlayUnrecorded(const Move& move)
 	{
+		using Traits = SideTraits<Us>;
+		using Opp = SideTraits<Traits::Them>;
+
 		ply++;
 		hash.castle(castling); // in case it changes we remove it from the hash code
 
-		Piece mPiece = board[move.origin]; // the moveing piece
-		PieceType mPieceT = pieceof(mPiece);
+		Square
+			origin = move.origin(),
+			target = move.target();
+		Move::Flags flags = move.flags();
 
-		MovePiece(move.origin, move.target);
+		Piece mPiece = board[origin]; // the moveing piece
+		Piece captured = board[target];
 
-		if (move.flags & Move::EnPassant)
-			RemovePiece(ep_target + (turn == Side::White ? SDir::S : SDir::N));
-		else if (move.flags & Move::Flags::Promotion) {
-			PieceType promoteTo = PieceType::Queen;
+		if (pieceof(mPiece) == PieceType::Pawn || captured != Piece::Empty)
+			halfmove = 0;
+		else
+			halfmove++;
 
-			switch (move.flags) {
-			case Move::PromoteR: promoteTo = PieceType::Rook; break;
-			case Move::PromoteN: promoteTo = PieceType::Knight; break;
-			case Move::PromoteB: promoteTo = PieceType::Bishop; break;
-			}
-			RemovePiece(move.target);
-			PlacePiece(move.target, promoteTo | turn);
-		}
-		else if (move.flags & Move::Castle) {
-			Square rookSquare = Square::a1;
-			if (move.target > move.origin)
-				rookSquare = Square(rankof(move.origin) * 8 + 7);
-			else
-				rookSquare = Square(rankof(move.origin) * 8);
+		MovePiece(origin, target);
 
-			MovePiece(rookSquare, Square((move.target + move.origin) / 2));
+		if (flags == Move::EnPassant)
+			RemovePiece(ep_target + Traits::Down);
+		else if (move.isPromotion()) {
+			RemovePiece(target);
+			PlacePiece(target, move.promotion() | Us);
+		}
+		else if (flags == Move::Castle) {
+			Square rookSquare = target > origin ? Traits::KingsideRook : Traits::QueensideRook;
 
-			if (turn == Side::White)
-				castling &= CastleFlag::BlackCastle; // clear white castle ability
-			else
-				castling &= CastleFlag::WhiteCastle; // clear black castle ability
+			MovePiece(rookSquare, Square((target + origin) / 2));
+			castling &= ~Traits::Castle;
 		}
 
 		if (ep_target != Square::InvalidSquare) { // clearing enpassant target
 			hash.enPassant(ep_target);
 			ep_target = Square::InvalidSquare;
 		}
-		if (move.flags & Move::DoublePush) { // writing en passant target
-			ep_target = move.origin + (turn == Side::White ? SDir::N : SDir::S);
+		if (flags == Move::DoublePush) { // writing en passant target
+			ep_target = origin + Traits::Up;
 			hash.enPassant(ep_target);
 		}
 
 		// castling state
-		if (mPiece == Piece::WRook) { // white rook moved
-			if (move.origin == Square::a1)
-				castling &= ~CastleFlag::WhiteQueenside;
-			else if (move.origin == Square::h1)
-				castling &= ~CastleFlag::WhiteKingside;
-		}
-		else if(mPiece == Piece::BRook) { // black rook moved
-			if (move.origin == Square::a8)
-				castling &= ~CastleFlag::BlackQueenside;
-			else if (move.origin == Square::h8)
-				castling &= ~CastleFlag::BlackKingside;
-		}
-		else if (mPiece == Piece::WKing) {
-			castling &= CastleFlag::BlackCastle; // clear white castle ability
+		if (mPiece == (PieceType::Rook | Us)) { // own rook moved
+			if (origin == Traits::QueensideRook)
+				castling &= ~Traits::Queenside;
+			else if (origin == Traits::KingsideRook)
+				castling &= ~Traits::Kingside;
 		}
-		else if (mPiece == Piece::BKing) {
-			castling &= CastleFlag::WhiteCastle; // clear black castle ability
+		else if (mPiece == (PieceType::King | Us)) {
+			castling &= ~Traits::Castle;
 		}
 		
-		if (move.captured == Piece::WRook) { // white rook captured
-			if (move.target == Square::a1)
-				castling &= ~CastleFlag::WhiteQueenside;
-			else if (move.target == Square::h1)
-				castling &= ~CastleFlag::WhiteKingside;
-		}
-		else if (move.captured == Piece::BRook) { // black rook captured
-			if (move.target == Square::a8)
-				castling &= ~CastleFlag::BlackQueenside;
-			else if (move.target == Square::h8)
-				castling &= ~CastleFlag::BlackKingside;
+		if (captured == (PieceType::Rook | Traits::Them)) { // enemy rook captured
+			if (target == Opp::QueensideRook)
+				castling &= ~Opp::Queenside;
+			else if (target == Opp::KingsideRook)
+				castling &= ~Opp::Kingside;
 		}
 		
 		hash.castle(castling); // add the new castling state
 
-		turn = otherside(turn);
+		turn = Traits::Them;
 		hash.flipSide();
 	}
 
 	void Board::PlayMove(const Move& move) {
-		CastleFlag castleState = castling;
+		moveRecord.push_back({ move, board[move.target()], castling, ep_target, halfmove, hash.key(), phash.key() });
 		PlayUnrecorded(move);
-		moveRecord.push_back({ move, castleState });
 	}
 
 	void Board::UnplayMove()
 	{
 		ply--;
 
-		MoveData moveData = moveRecord.pop_back();
+		const MoveData& moveData = moveRecord.back();
 		const Move& move = moveData.move;
+		Square
+			origin = move.origin(),
+			target = move.target();
+		Move::Flags flags = move.flags();
+
 		turn = otherside(turn);
-		hash.flipSide();
 
-		MovePiece(move.target, move.origin);
+		Piece moved = move.isPromotion() ? PieceType::Pawn | turn : board[target];
+		ClearPiece(target);
+		SetPiece(origin, moved);
 
-		if (move.captured != Piece::Empty)
-			PlacePiece(move.target, move.captured);
+		if (moveData.captured != Piece::Empty)
+			SetPiece(target, moveData.captured);
 
-		if (move.flags & Move::Flags::Promotion) {
-			RemovePiece(move.origin);
-			PlacePiece(move.origin, PieceType::Pawn | turn);
-		}
-		else if (move.flags & Move::EnPassant) {
-			Square pawnSquare =
-				fileof(move.target) - fileof(move.origin) > 0 ?
-				move.origin + SDir::E :
-				move.origin + SDir::W;
-			PlacePiece(pawnSquare, PieceType::Pawn | otherside(turn));
-		}
-		else if (move.flags & Move::Castle) {
+		if (flags == Move::EnPassant)
+			SetPiece(moveData.epTarget + (turn == Side::White ? SDir::S : SDir::N), PieceType::Pawn | otherside(turn));
+		else if (flags == Move::Castle) {
 			Square
-				rookSquare = (Square)((move.target + move.origin) / 2),
-				rookTarget =
-					fileof(rookSquare) < 4 ?
-					Square(rankof(rookSquare) * 8) :
-					Square(rankof(rookSquare) * 8 + 7);
-			MovePiece(rookSquare, rookTarget);
+				rookSquare = (Square)((target + origin) / 2),
+				rookOrigin = target > origin ?
+					Square(rankof(origin) * 8 + 7) :
+					Square(rankof(origin) * 8);
+			ClearPiece(rookSquare);
+			SetPiece(rookOrigin, PieceType::Rook | turn);
 		}
 
-		hash.castle(castling);
 		castling = moveData.castle;
-		hash.castle(castling);
+		ep_target = moveData.epTarget;
+		halfmove = moveData.halfmove;
+		hash.restore(moveData.key);
+		phash.restore(moveData.pawnKey);
 
-		//en passant
-		if (ep_target != Square::InvalidSquare) { // clearing enpassant target
+		moveRecord.pop_back();
+		keyHistory.pop_back();
+	}
+
+	void Board::PlayNullMove()
+	{
+		moveRecord.push_back({ Move(), Piece::Empty, castling, ep_target, halfmove, hash.key(), phash.key() });
+		keyHistory.push_back(hash.key());
+
+		ply++;
+		halfmove = 0; // a line through a null move is no real repetition, the count restarts
+
+		if (ep_target != Square::InvalidSquare) {
 			hash.enPassant(ep_target);
 			ep_target = Square::InvalidSquare;
 		}
 
-		if (moveRecord.size() == 0) {
-			ep_target = ep_start;
-			hash.enPassant(ep_target);
-		}
-		else if (moveRecord.back().move.flags & Move::DoublePush) {
-			ep_target = moveRecord.back().move.origin + (turn == Side::White ? SDir::S : SDir::N);
-			hash.enPassant(ep_target);
-		}
+		turn = otherside(turn);
+		hash.flipSide();
 	}
 
-	const Piece& Board::operator [] (Square square) const { // TODO call array op.
-		if (!validsquare(square))
-			throw std::out_of_range("square was invalid");
+	void Board::UnplayNullMove()
+	{
+		const MoveData& moveData = moveRecord.back();
+
+		ply--;
+		turn = otherside(turn);
+		ep_target = moveData.epTarget;
+		halfmove = moveData.halfmove;
+		hash.restore(moveData.key);
+
+		moveRecord.pop_back();
+		keyHistory.pop_back();
+	}
+
+	Piece Board::Captured(const Move& move) const {
+		if (move.flags() == Move::EnPassant)
+			return PieceType::Pawn | otherside(turn);
+		return board[move.target()];
+	}
+
+	const Piece& Board::operator [] (Square square) const {
 		return board[square];
 	}
 
@@ -218,6 +240,22 @@ namespace GGChess
 		return board;
 	}
 
+	BitBoard Board::Occupied() const {
+		return occupied;
+	}
+
+	BitBoard Board::Pieces(Side side) const {
+		return sidePieces[sideidx(side)];
+	}
+
+	BitBoard Board::Pieces(PieceType piece) const {
+		return typePieces[size_t(piece)];
+	}
+
+	BitBoard Board::Pieces(PieceType piece, Side side) const {
+		return typePieces[size_t(piece)] & sidePieces[sideidx(side)];
+	}
+
 	Square Board::EPTarget() const {
 		return ep_target;
 	}
@@ -230,45 +268,105 @@ namespace GGChess
 		return castling;
 	}
 
+	int Board::HalfMove() const {
+		return halfmove;
+	}
+
+	bool Board::IsDraw(int ply) const
+	{
+		if (halfmove >= 100 && !Checkers())
+			return true;
+
+		// only positions with the same side to move since the last irreversible move can repeat
+		int last = std::min<int>(halfmove, int(keyHistory.size()));
+		bool repeated = false;
+
+		for (int i = 4; i <= last; i += 2) {
+			if (keyHistory[keyHistory.size() - i] == hash.key()) {
+				if (i <= ply || repeated)
+					return true;
+				repeated = true;
+			}
+		}
+		return false;
+	}
+
+	// without pieces besides pawns zugzwang is common, passing the turn is no safe lower bound there
+	bool Board::HasNonPawnMaterial(Side side) const {
+		return bool(Pieces(side) & ~(Pieces(PieceType::Pawn) | Pieces(PieceType::King)));
+	}
+
 	int Board::Ply() const {
 		return ply;
 	}
 
 	void Board::SetThisAsStart() {
-		ep_start = ep_target;
 		moveRecord.clear();
+		TrimKeyHistory();
+	}
+
+	void Board::TrimKeyHistory()
+	{
+		size_t keep = std::min<size_t>(halfmove, keyHistory.size());
+		size_t first = keyHistory.size() - keep;
+
+		FastArray<ZobristKey, KEY_HISTORY_SIZE> recent;
+		for (size_t i = first; i < keyHistory.size(); i++)
+			recent.push_back(keyHistory[i]);
+		keyHistory = recent;
 	}
 
 	void Board::PlacePiece(Square square, Piece piece)
 	{
-		board[square] = piece;
 		hash.piece(piece, square);
 
 		if (pieceof(piece) == PieceType::Pawn)
 			phash.piece(piece, square);
 
+		SetPiece(square, piece);
+	}
+
+	void Board::SetPiece(Square square, Piece piece)
+	{
+		board[square] = piece;
+
+		occupied.Set(square, true);
+		sidePieces[sideidx(sideof(piece))].Set(square, true);
+		typePieces[size_t(pieceof(piece))].Set(square, true);
+
 		if (piece == Piece::WKing)
 			whiteKing = square;
 		else if (piece == Piece::BKing)
 			blackKing = square;
 	}
 
-	void Board::RemovePiece(Square square)
+	void Board::ClearPiece(Square square)
 	{
 		Piece piece = board[square];
-		hash.piece(piece, square);
-
-		if (pieceof(piece) == PieceType::Pawn)
-			phash.piece(piece, square);
 
 		if (piece == Piece::WKing)
 			whiteKing = Square::InvalidSquare;
 		else if (piece == Piece::BKing)
 			blackKing = Square::InvalidSquare;
 
+		occupied.Set(square, false);
+		sidePieces[sideidx(sideof(piece))].Set(square, false);
+		typePieces[size_t(pieceof(piece))].Set(square, false);
+
 		board[square] = Piece::Empty;
 	}
 
+	void Board::RemovePiece(Square square)
+	{
+		Piece piece = board[square];
+		hash.piece(piece, square);
+
+		if (pieceof(piece) == PieceType::Pawn)
+			phash.piece(piece, square);
+
+		ClearPiece(square);
+	}
+
 	void Board::MovePiece(Square origin, Square target)
 	{
 		Piece p = board[origin];
@@ -292,126 +390,59 @@ namespace GGChess
 	{
 		PosInfo info;
 		Side attacker = otherside(turn);
-
 		Square square = King(turn);
-		int checkCount = 0;
 
-		KnightPattern(square, [&](Square target) {
-			if (pieceof(board[target]) == PieceType::Knight && sideof(board[target]) == attacker) {
-				info.checkBoard.Set(target, true);
-				checkCount++;
-			}
-			return true;
-			});
-
-		PawnPattern(square, turn, [&](Square target, bool attack) {
-			if (pieceof(board[target]) == PieceType::Pawn && sideof(board[target]) == attacker) {
-				info.checkBoard.Set(target, true);
-				checkCount++;
-			}
-			return true;
-			}, true);
+		info.checkers = Checkers();
+		info.check = bool(info.checkers);
+		info.doubleCheck = info.checkers.several();
+		info.checkBoard = info.checkers;
 
-		BitBoard current;
-		int myPieceCount = 0;
-		int lastIdx = 0;
+		if (info.check && !info.doubleCheck)
+			info.checkBoard |= Attacks::Between(square, info.checkers.lsb());
 
-		SlidingPiecePattern(square, PieceType::Queen, [&](Square target, int rayIdx) {
-			if (rayIdx != lastIdx) {
-				current.bits = 0;
-				myPieceCount = 0;
-				lastIdx = rayIdx;
-			}
-			Piece targetPiece = board[target];
-			current.Set(target, true);
-
-			if (targetPiece != Piece::Empty) {
-				if (sideof(targetPiece) == turn)
-					myPieceCount++;
-				else {
-					PieceType p = pieceof(targetPiece);
-					bool canAttack =
-						p == PieceType::Queen ||
-						(p == PieceType::Bishop && rayIdx % 2 == 1) ||
-						(p == PieceType::Rook && rayIdx % 2 == 0);
-
-					if (canAttack) {
-						if (myPieceCount == 0) {
-							info.checkBoard.Set(current.bits, true);
-							checkCount++;
-						}
-						else if (myPieceCount == 1)
-							info.pinBoards[rayIdx].Set(current.bits, true);
-					}
-					return false;
-				}
-			}
-			if (myPieceCount > 1)
-				return false;
-			return true;
-			});
+		// x-ray from the king: a slider with exactly one friendly piece in between pins it
+		BitBoard
+			queens = Pieces(PieceType::Queen, attacker),
+			snipers =
+				(Attacks::Bishop(square, 0) & (Pieces(PieceType::Bishop, attacker) | queens)) |
+				(Attacks::Rook(square, 0) & (Pieces(PieceType::Rook, attacker) | queens));
 
-		if (checkCount > 0)
-			info.check = true;
-		if (checkCount > 1)
-			info.doubleCheck = true;
+		for (Square target : snipers) {
+			BitBoard blockers = Attacks::Between(square, target) & occupied;
 
-		for (BitBoard& pin : info.pinBoards)
-			info.unifiedPinBoard.Set(pin.bits, true);
-
-		// attack board
-		BitBoard pbf, pbo;
-
-		for (int8_t i = 0; i < BOARD_SQUARE_COUNT; i++) {
-			Piece p = board[i];
-
-			if (p == Piece::Empty || sideof(p) != attacker) {
-				if (pieceof(p) == PieceType::Pawn)
-					pbf.Set(Square(i), true);
-				continue;
-			}
-
-			switch (pieceof(p)) {
-			case PieceType::Pawn:
-				pbo.Set(Square(i), true);
-				break;
-			case PieceType::Knight:
-				KnightPattern(Square(i), [&](Square target) {
-					info.attackBoard.Set(target, true);
-					return true;
-					});
-				break;
-			case PieceType::King:
-				SlidingPiecePattern(Square(i), PieceType::Queen, [&](Square target, int rayIdx) {
-					info.attackBoard.Set(target, true);
-					return false;
-					});
-				break;
-			case PieceType::Bishop:
-			case PieceType::Rook:
-			case PieceType::Queen:
-				SlidingPiecePattern(Square(i), pieceof(p), [&](Square target, int rayIdx) {
-					info.attackBoard.Set(target, true);
-					return (board[target] == Piece::Empty) || target == King(turn);
-					});
-				break;
-			}
+			if (blockers && !blockers.several() && (blockers & Pieces(turn)))
+				info.pinned |= blockers;
 		}
 
-		const uint64_t
-			fileA = 0x0101010101010101ULL,
-			fileH = fileA << 7;
+		return info;
+	}
 
-		size_t idx = turn == Side::White ? 0 : 1;
-		info.pAttackBoard[idx] = pbf.pawnAttack(turn);
+	BitBoard Board::Checkers() const {
+		return AttackersTo(King(turn), occupied) & Pieces(otherside(turn));
+	}
 
-		idx = turn == Side::White ? 1 : 0;
-		info.pAttackBoard[idx] = pbo.pawnAttack(attacker);
+	BitBoard Board::AttackersTo(Square square, BitBoard occupied) const
+	{
+		BitBoard queens = Pieces(PieceType::Queen);
+
+		return
+			(Attacks::Pawn(square, Side::White) & Pieces(PieceType::Pawn, Side::Black)) |
+			(Attacks::Pawn(square, Side::Black) & Pieces(PieceType::Pawn, Side::White)) |
+			(Attacks::Knight(square) & Pieces(PieceType::Knight)) |
+			(Attacks::King(square) & Pieces(PieceType::King)) |
+			(Attacks::Bishop(square, occupied) & (Pieces(PieceType::Bishop) | queens)) |
+			(Attacks::Rook(square, occupied) & (Pieces(PieceType::Rook) | queens));
+	}
 
+	BitBoard Board::AttackMap(Side attacker) const
+	{
+		BitBoard attacks = Pieces(PieceType::Pawn, attacker).pawnAttack(attacker);
 
-		info.attackBoard.Set(info.pAttackBoard[idx].bits, true);
+		for (PieceType p : { PieceType::King, PieceType::Queen, PieceType::Bishop, PieceType::Knight, PieceType::Rook })
+			for (Square from : Pieces(p, attacker))
+				attacks |= Attacks::Of(p, from, occupied);
 
-		return info;
+		return attacks;
 	}
 
 	ZobristKey Board::Key() const {
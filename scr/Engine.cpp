@@ -0,0 +1,107 @@
+#include "Engine.h"
+
+#include <algorithm>
+#include <future>
+#include <limits>
+
+#include "Search.h"
+#include "ThreadPool.h"
+#include "TransposTable.h"
+#include "InputHandler.h"
+
+namespace GGChess
+{
+	// engines alive in the process, all of them share tpostable
+	static std::atomic<size_t> engineCount(0);
+
+	Engine::Engine() :
+		position(), contexts(), helpers(), stop(false)
+	{
+		engineCount++;
+		SetThreads(1);
+	}
+
+	Engine::~Engine() {
+		engineCount--;
+	}
+
+	Board& Engine::Position() {
+		return position;
+	}
+
+	void Engine::NewGame()
+	{
+		position = Board();
+		for (std::unique_ptr<SearchContext>& ctx : contexts)
+			ctx->history.clear();
+
+		// another engine may be searching the table, its old entries only age out then
+		if (engineCount == 1)
+			tpostable.clear(Threads());
+	}
+
+	Move Engine::Search(const Limits& limits)
+	{
+		stop = false;
+		tpostable.newSearch();
+
+		// the helpers copy the position here, the main thread must not touch it after submitting
+		std::vector<std::future<void>> running;
+		for (size_t i = 0; i < contexts.size(); i++) {
+			SearchContext& ctx = *contexts[i];
+
+			ctx.board = position;
+			ctx.data.reset();
+			ctx.data.side = position.Turn();
+
+			if (ctx.isMain())
+				ctx.data.allocTime(limits, position);
+			else
+				ctx.data.movetime = std::numeric_limits<uint64_t>::max(); // runs until the main thread stops
+		}
+
+		for (size_t i = 1; i < contexts.size(); i++) {
+			SearchContext* ctx = contexts[i].get();
+			running.push_back(helpers->submit([ctx]() { IterativeDeepening(*ctx); }));
+		}
+
+		SearchContext& main = *contexts[0];
+		IterativeDeepening(main);
+
+		stop = true;
+		for (std::future<void>& helper : running)
+			helper.get();
+
+		printSearchData(main, true);
+		return main.data.best.myMove;
+	}
+
+	void Engine::SetThreads(size_t count)
+	{
+		count = std::clamp<size_t>(count, 1, MAX_THREADS);
+		if (count == contexts.size())
+			return;
+
+		helpers.reset(count > 1 ? new ThreadPool(count - 1) : nullptr);
+
+		contexts.clear();
+		for (size_t i = 0; i < count; i++)
+			contexts.push_back(std::make_unique<SearchContext>(*this, i));
+	}
+
+	size_t Engine::Threads() const {
+		return contexts.size();
+	}
+
+	bool Engine::Stopped() const {
+		return stop.load(std::memory_order_relaxed);
+	}
+
+	uint64_t Engine::Nodes() const
+	{
+		uint64_t nodes = 0;
+		for (const std::unique_ptr<SearchContext>& ctx : contexts)
+			nodes += ctx->data.nodes.load(std::memory_order_relaxed);
+		return nodes;
+	}
+}
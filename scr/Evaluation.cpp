@@ -3,7 +3,7 @@
 #include "BasicTypes.h"
 #include "TransposTable.h"
 #include "Board.h"
-#include "MovePatterns.h"
+#include "Attacks.h"
 
 namespace GGChess
 {
@@ -18,40 +18,42 @@ namespace GGChess
 		{}
 	};
 
-	Value KingShields(Board& board) {
-		const Side sides[2] = { Side::White, Side::Black };
-		const Piece myPawn[2] = { Piece::WPawn, Piece::BPawn };
-		const SDir dir[2] = { SDir::N, SDir::S };
-		const Square base[2] = { Square::a2, Square::a7 };
+	// scores below are white relative, Evaluate turns them to the side to move
+	template<Side Us>
+	Value KingShield(Board& board) {
+		using Traits = SideTraits<Us>;
+		constexpr Piece myPawn = PieceType::Pawn | Us;
 
+		Square king = board.King(Us);
+		Square shield = Traits::IsWhite ? Square::a2 : Square::a7;
 		Value shield_score = 0;
 
-		for (size_t i = 0; i < 2; i++) {
-			Square king = board.King(sides[i]);
-			Square shield = base[i];
-			Value persp = sides[i] == board.Turn() ? 1 : -1;
-
-			if (rankof(king) > 4) // king stands on the kingside
-				shield = shield + 5;
+		if (fileof(king) > 4) // king stands on the kingside
+			shield = shield + 5;
 
-			for (uint8_t delta = 0; delta < 3; delta++, shield = shield + 1) {
-				if (board[shield] == myPawn[i])
-					shield_score += 10 * persp; // shield stands on rank 2
-				else if (board[shield + dir[i]] == myPawn[i])
-					shield_score += 5 * persp; // shield on rank 3
-			}
+		for (uint8_t delta = 0; delta < 3; delta++, shield = shield + 1) {
+			if (board[shield] == myPawn)
+				shield_score += 10; // shield stands on rank 2
+			else if (board[shield + Traits::Up] == myPawn)
+				shield_score += 5; // shield on rank 3
 		}
-		return shield_score;
+		return shield_score * Traits::Sign;
+	}
+
+	Value KingShields(Board& board) {
+		return KingShield<Side::White>(board) + KingShield<Side::Black>(board);
 	}
 
-	void PawnEval(Board& board, const PosInfo& info, EvalData& score, Square square, Side side)
+	template<Side Us>
+	void PawnEval(Board& board, EvalData& score, Square square)
 	{
-		SDir dir = side == Side::White ? SDir::N : SDir::S;
-		Value persp = side == board.Turn() ? 1 : -1;
+		using Traits = SideTraits<Us>;
+		constexpr SDir dir = Traits::Up;
+		constexpr Value persp = Traits::Sign;
 
-		Piece
-			opposition = PieceType::Pawn | otherside(side),
-			friendly = PieceType::Pawn | side;
+		constexpr Piece
+			opposition = PieceType::Pawn | Traits::Them,
+			friendly = PieceType::Pawn | Us;
 
 		bool
 			passedFlag = true,
@@ -60,7 +62,7 @@ namespace GGChess
 
 		bool fileA = fileof(square) == 0;
 		bool fileH = fileof(square) == 7;
-		uint8_t maxStep = side == Side::White ? 8 - rankof(square) : rankof(square) + 1;
+		uint8_t maxStep = Traits::IsWhite ? 8 - rankof(square) : rankof(square) + 1;
 
 		Square target = square + dir;
 		for (uint8_t step = 1; step < maxStep; step++) {
@@ -69,7 +71,7 @@ namespace GGChess
 				passedFlag = false;
 			}
 			else if (board[target] == friendly) {
-				score.pawn -= 20; // doubled pawn
+				score.pawn -= 20 * persp; // doubled pawn
 				passedFlag = false;
 			}
 
@@ -97,7 +99,7 @@ namespace GGChess
 			target = target - dir;
 		}
 
-		Square pstSquare = side == Side::White ? square : flipside(square);
+		Square pstSquare = Traits::IsWhite ? square : flipside(square);
 
 		if (passedFlag)
 			score.pawn += PSTables::passedPawn[rankof(pstSquare)] * persp;
@@ -105,114 +107,91 @@ namespace GGChess
 		if (weakFlag) {
 			score.pawn += PSTables::weakPawn[fileof(pstSquare)] * persp;
 			if (!opposedFlag)
-				score.pawn -= 4;
+				score.pawn -= 4 * persp;
 		}
 	}
 
-	void KnightEval(Board& board, const PosInfo& info, EvalData& score, Square square, Piece piece)
+	template<Side Us>
+	void KnightEval(Board& board, EvalData& score, Square square)
 	{
-		Value persp = sideof(piece) == board.Turn() ? 1 : -1;
-		uint8_t
-			mobility = 0,
-			nearKing = 0;
-
-		Side side = sideof(piece);
-		size_t oIdx = side == Side::White ? 1 : 0; // index of opposition
-
-		KnightPattern(square, [&](Square target) {
-			if (sideof(board[target]) != side) {
-				if (!info.pAttackBoard[oIdx].Get(target))
-					mobility++;
-				if (isnear(target, board.King(otherside(side))))
-					nearKing++;
-			}
-			return true;
-			});
+		using Traits = SideTraits<Us>;
+		constexpr Value persp = Traits::Sign;
+
+		BitBoard guarded = board.Pieces(PieceType::Pawn, Traits::Them).template pawnAttack<Traits::Them>();
+
+		Square enemyKing = board.King(Traits::Them);
+		BitBoard
+			targets = Attacks::Knight(square) & ~board.Pieces(Us),
+			kingZone = Attacks::King(enemyKing) | bitof(enemyKing);
+
+		int
+			mobility = (targets & ~guarded).popcount(),
+			nearKing = (targets & kingZone).popcount();
 
 		score.middlegame += 4 * (mobility - 4) * persp;
 		score.endgame += 4 * (mobility - 4) * persp;
 		//score.nearKing += nearKing * 2;
 	}
 
-	void SlidingPieceEval(Board& board, const PosInfo& info, EvalData& score, Square square, Piece piece)
+	template<Side Us>
+	void SlidingPieceEval(Board& board, EvalData& score, Square square, PieceType pt)
 	{
+		using Traits = SideTraits<Us>;
+
 		const Value
 			mgMob[PIECE_COUNT] = { 0, 0, 1, 3, 4, 2, 0 },
 			egMob[PIECE_COUNT] = { 0, 0, 2, 3, 4, 4, 0 };
 
 		uint8_t nkValue[PIECE_COUNT] = { 0, 0, 4, 2, 2, 3, 0 };
 
-		Value persp = sideof(piece) == board.Turn() ? 1 : -1;
-		uint8_t
-			mobility = 0,
-			nearKing = 0;
-
-		Side side = sideof(piece);
-		PieceType pt = pieceof(piece);
-		size_t oIdx = side == Side::White ? 1 : 0; // index of opposition
-
-		SlidingPiecePattern(square, pt, [&](Square target, int rayIdx) {
-			Piece t = board[target];
-			if (t == Piece::Empty) {
-				if (!info.pAttackBoard[oIdx].Get(target))
-					mobility++;
-				if (isnear(target, board.King(otherside(side))))
-					nearKing++;
-			}
-			else {
-				if (sideof(board[target]) != side) {
-					mobility++;
-					if (isnear(target, board.King(otherside(side))))
-						nearKing++;
-				}
-				return false;
-			}
-			return true;
-			});
+		constexpr Value persp = Traits::Sign;
+
+		BitBoard guarded = board.Pieces(PieceType::Pawn, Traits::Them).template pawnAttack<Traits::Them>();
+
+		Square enemyKing = board.King(Traits::Them);
+		BitBoard
+			targets = Attacks::Of(pt, square, board.Occupied()) & ~board.Pieces(Us),
+			kingZone = Attacks::King(enemyKing) | bitof(enemyKing);
+
+		// empty squares only count when no enemy pawn guards them
+		int
+			mobility = (targets & (board.Occupied() | ~guarded)).popcount(),
+			nearKing = (targets & kingZone).popcount();
 
 		score.middlegame += mgMob[int(pt)] * mobility * persp;
 		score.endgame += egMob[int(pt)] * mobility * persp;
 		//score.nearKing += nkValue[int(pt)] * nearKing;
 	}
 
-	void PieceEval(Board& board, const PosInfo& info, EvalData& score, Square square, Piece piece)
+	template<Side Us>
+	void PieceEval(Board& board, EvalData& score, Square square, PieceType pt)
 	{
-		switch (pieceof(piece)) {
+		switch (pt) {
 		case PieceType::Knight:
-			KnightEval(board, info, score, square, piece);
+			KnightEval<Us>(board, score, square);
 			break;
 		case PieceType::Bishop:
 		case PieceType::Rook:
 		case PieceType::Queen:
-			SlidingPieceEval(board, info, score, square, piece);
+			SlidingPieceEval<Us>(board, score, square, pt);
 			break;
 		}
 	}
 
-	Value Evaluate(Board& board, const PosInfo& info)
+	// material, piece square tables and pawn structure of one side
+	template<Side Us>
+	void EvaluateSide(Board& board, EvalData& score, bool ptt_hit)
 	{
-		SimpleTTEntry ttentry;
-		if (tpostable.ett_probe(board.Key(), ttentry))
-			return ttentry.eval;
+		using Traits = SideTraits<Us>;
+		constexpr Value persp = Traits::Sign;
 
-		EvalData score;
-
-		SimpleTTEntry entry;
-		bool ptt_hit = tpostable.ptt_probe(board.PKey(), entry);
-		if (ptt_hit)
-			score.pawn = entry.eval;
-
-		for (int i = 0; i < 64; i++) {
-			Piece p = board[(Square)i];
-			PieceType pt = pieceof(p);
-
-			if (p == Piece::Empty)
-				continue;
+		for (Square i : board.Pieces(Us)) {
+			PieceType pt = pieceof(board[i]);
 
 			if (!ptt_hit && pt == PieceType::Pawn)
-				PawnEval(board, info, score, Square(i), sideof(p));
+				PawnEval<Us>(board, score, i);
 			//else
-				//PieceEval(board, info, score, Square(i), p);
+				//PieceEval<Us>(board, score, i, pt);
 
 			switch (pt) {
 			case PieceType::Bishop: score.bishops++; break;
@@ -220,9 +199,6 @@ namespace GGChess
 			case PieceType::Rook: score.rooks++; break;
 			}
 
-			Side ps = sideof(p);
-			Value persp = ps == board.Turn() ? 1 : -1;
-
 			//game phase
 			score.phase += phaseInc[(int)pt];
 
@@ -231,16 +207,36 @@ namespace GGChess
 			score.material += pieceValue * persp;
 
 			// piece square table
-			Square square = ps == Side::White ? flipside(Square(i)) : Square(i);
+			Square square = Traits::IsWhite ? flipside(i) : i;
 			score.middlegame += PSTables::middlegame[(int)pt][square] * persp;
 			score.endgame += PSTables::endgame[(int)pt][square] * persp;
-		}			
+		}
+	}
+
+	Value Evaluate(Board& board)
+	{
+		Value cached;
+		if (tpostable.ett_probe(board.Key(), cached))
+			return cached;
+
+		EvalData score;
+
+		bool ptt_hit = tpostable.ptt_probe(board.PKey(), score.pawn);
+
+		EvaluateSide<Side::White>(board, score, ptt_hit);
+		EvaluateSide<Side::Black>(board, score, ptt_hit);
+
+		if (!ptt_hit)
+			tpostable.ptt_save(board.PKey(), score.pawn);
 
 		// phase blend
 		score.phase = std::min(score.phase, 24);
 		Value phaseScore = (score.middlegame * score.phase + score.endgame * (24 - score.phase)) / 24;
 
-		Value finalScore = score.material + phaseScore + score.pawn;
+		Value finalScore = score.material + phaseScore + score.pawn + KingShields(board);
+
+		if (board.Turn() == Side::Black)
+			finalScore = -finalScore;
 
 		// rewards and penalties for pieces
 		if (score.bishops > 1)
@@ -251,7 +247,6 @@ namespace GGChess
 			finalScore -= 16;
 
 		// king safety
-		finalScore += KingShields(board);
 		//finalScore -= PSTables::kingSafetyTable[score.nearKing];
 
 		tpostable.ett_save(board.Key(), finalScore);
@@ -1,6 +1,7 @@
 #include "Fen.h"
 
 #include <sstream>
+#include <algorithm>
 #include <iostream>
 
 #include "Board.h"
@@ -17,11 +18,21 @@ namespace GGChess
 	{
 		for (size_t i = 0; i < 64; i++)
 			board.board[i] = Piece::Empty;
-		
+
+		board.occupied = BitBoard();
+		board.sidePieces[0] = board.sidePieces[1] = BitBoard();
+		for (BitBoard& pieces : board.typePieces)
+			pieces = BitBoard();
+
+		board.hash = ZobristHash();
+		board.phash = ZobristHash();
+		board.halfmove = 0;
+		board.moveRecord.clear();
+		board.keyHistory.clear();
+
 		std::string sec1, sec2, sec3;
-		int valami; // TODO halfmove, passive move input
-		stream >> sec1 >> sec2 >> sec3 >> board.ep_start >> valami >> valami;
-		board.ep_target = board.ep_start;
+		int fullmove = 1;
+		stream >> sec1 >> sec2 >> sec3 >> board.ep_target >> board.halfmove >> fullmove;
 
 		int file = 0, rank = 7;
 
@@ -42,6 +53,7 @@ namespace GGChess
 			}
 		}
 		board.turn = sec2 == "w" ? Side::White : Side::Black;
+		board.ply = 2 * (std::max(fullmove, 1) - 1) + (board.turn == Side::Black);
 
 		CastleFlag castle = (CastleFlag)0;
 		size_t end = std::string::npos;
@@ -50,6 +62,11 @@ namespace GGChess
 		if (sec3.find('q') != end) castle |= CastleFlag::BlackQueenside;
 		if (sec3.find('k') != end) castle |= CastleFlag::BlackKingside;
 		board.castling = castle;
+
+		board.hash.castle(board.castling);
+		board.hash.enPassant(board.ep_target);
+		if (board.turn == Side::Black)
+			board.hash.flipSide();
 	}
 
 	void Fen::Set(Board& board, const std::string& fen)
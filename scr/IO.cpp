@@ -24,12 +24,15 @@ namespace std
 	std::string to_string(const GGChess::Move& move)
 	{
 		char promote = 0;
-		if (move.flags & GGChess::Move::PromoteQ) promote = 'q';
-		else if (move.flags & GGChess::Move::PromoteR) promote = 'r';
-		else if (move.flags & GGChess::Move::PromoteN) promote = 'n';
-		else if (move.flags & GGChess::Move::PromoteB) promote = 'b';
+		switch (move.flags()) {
+		case GGChess::Move::PromoteQ: promote = 'q'; break;
+		case GGChess::Move::PromoteR: promote = 'r'; break;
+		case GGChess::Move::PromoteN: promote = 'n'; break;
+		case GGChess::Move::PromoteB: promote = 'b'; break;
+		default: break;
+		}
 
-		std::string str = to_string(move.origin) + std::to_string(move.target);
+		std::string str = to_string(move.origin()) + std::to_string(move.target());
 		if (promote)
 			str += promote;
 
@@ -119,8 +122,8 @@ namespace GGChess
 
 	std::ostream& operator << (std::ostream& stream, const Move& move)
 	{
-		stream << std::to_string(move.origin) << std::to_string(move.target);
-		switch (move.flags) {
+		stream << std::to_string(move.origin()) << std::to_string(move.target());
+		switch (move.flags()) {
 		case Move::Flags::PromoteQ: stream << 'q'; break;
 		case Move::Flags::PromoteR: stream << 'r'; break;
 		case Move::Flags::PromoteN: stream << 'n'; break;
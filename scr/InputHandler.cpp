@@ -4,33 +4,73 @@
 #include <string>
 #include <sstream>
 #include <list>
+#include <algorithm>
 
 #include "Board.h"
+#include "Engine.h"
 #include "Fen.h"
 #include "IO.h"
 #include "MoveGenerator.h"
+#include "Perft.h"
 #include "Search.h"
-#include "ThreadPool.h"
+#include "TransposTable.h"
 
 namespace GGChess
 {
 	static const char* startpos = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
 
-	static Board internalBoard;
+	static Engine engine;
 
 	static void PrintEngineData()
 	{
 		UCI_ID(GGChess, Kavefozogepezet);
+		std::cout << "option name Threads type spin default 1 min 1 max " << MAX_THREADS << std::endl;
+		std::cout << "option name Hash type spin default " << TT_DEFAULT_MB << " min 1 max " << MAX_HASH_MB << std::endl;
+		std::cout << "option name PawnHash type spin default " << PTT_DEFAULT_MB << " min 0 max " << MAX_HASH_MB << std::endl;
+		std::cout << "option name EvalHash type spin default " << ETT_DEFAULT_MB << " min 0 max " << MAX_HASH_MB << std::endl;
+		UCI_OK;
+	}
+
+	// setoption name <name> value <value>
+	static void SetOption(std::stringstream& stream)
+	{
+		std::string token, name, value;
+		stream >> token; // name
+
+		while (stream >> token && token != "value")
+			name += name.empty() ? token : " " + token;
+		stream >> value;
+
+		std::stringstream valueStream(value);
+
+		if (name == "Threads") {
+			size_t threads = 1;
+			valueStream >> threads;
+			engine.SetThreads(threads);
+		}
+		else if (name == "Hash" || name == "PawnHash" || name == "EvalHash") {
+			size_t mb = 0;
+			valueStream >> mb;
+			size_t bytes = std::min(mb, MAX_HASH_MB) * 1024 * 1024;
+
+			if (name == "Hash")
+				tpostable.resize(std::max<size_t>(bytes, 1024 * 1024));
+			else if (name == "PawnHash")
+				tpostable.ptt_resize(bytes);
+			else
+				tpostable.ett_resize(bytes);
+		}
 	}
 
 	static void ReadPosition(std::stringstream& stream)
 	{
+		Board& board = engine.Position();
 		std::string temp;
 		stream >> temp;
 		if (temp == "startpos")
-			Fen::Set(internalBoard, startpos);
+			Fen::Set(board, startpos);
 		else if (temp == "fen")
-			Fen::Set(internalBoard, stream);
+			Fen::Set(board, stream);
 
 		stream >> temp;
 		if (temp == "moves") {
@@ -50,22 +90,22 @@ namespace GGChess
 				}
 
 				MoveList moves;
-				GetMoves(internalBoard, internalBoard.Info(), s1, moves);
+				GetMoves(board, board.Info(), s1, moves);
 
 				for (const Move& move : moves) {
-					if (move.origin == s1 && move.target == s2) {
+					if (move.origin() == s1 && move.target() == s2) {
 						if (c) {
-							if (move.flags == flags)
-								internalBoard.PlayUnrecorded(move);
+							if (move.flags() == flags)
+								board.PlayUnrecorded(move);
 						}
 						else {
-							internalBoard.PlayUnrecorded(move);
+							board.PlayUnrecorded(move);
 						}
 					}
 				}
 			}
 		}
-		internalBoard.SetThisAsStart();
+		board.SetThisAsStart();
 	}
 
 	static void ExecuteGo(std::stringstream& stream)
@@ -82,70 +122,115 @@ namespace GGChess
 			else if (limit_name == "binc") stream >> limits.binc;
 		}
 
-		Move best = Search(internalBoard, limits);
+		Move best = engine.Search(limits);
 		UCI_BESTMOVE(best);
 	}
 
+	// [copy] [threads <count>] [hash <MB>]
+	static PerftSettings ReadPerftSettings(std::stringstream& stream)
+	{
+		PerftSettings settings;
+		std::string option;
+		while (stream >> option) {
+			if (option == "copy")
+				settings.copyMake = true;
+			else if (option == "threads")
+				stream >> settings.threads;
+			else if (option == "hash")
+				stream >> settings.hashMB;
+		}
+		return settings;
+	}
+
+	// perft <depth> [settings]
 	static void ExecutePerft(std::stringstream& stream)
 	{
-		size_t depth;
+		Board& board = engine.Position();
+		size_t depth = 0;
 		stream >> depth;
 
-		std::cout << "searching at depth " << depth << " on position:\n" << internalBoard << "\n\n";
+		PerftSettings settings = ReadPerftSettings(stream);
+
+		std::cout << "searching at depth " << depth << " on position:\n" << board << "\n\n";
 
 		if (depth <= 0) {
 			std::cout << 1 << std::endl;
 			return;
 		}
 
-		MoveList moves;
-		GetAllMoves(internalBoard, internalBoard.Info(), moves);
-		size_t pos = 0;
+		Timer timer;
+		uint64_t pos = 0;
 
-		for (Move& move : moves) {
-			internalBoard.PlayMove(move);
-			size_t subpos = Perft(depth - 1, internalBoard);
-			pos += subpos;
-			std::cout << move << ": " << subpos << "\n";
-			internalBoard.UnplayMove();
+		for (const PerftResult& result : PerftDivide(depth, board, settings)) {
+			pos += result.nodes;
+			std::cout << result.move << ": " << result.nodes << "\n";
 		}
+
+		uint64_t elapsed = timer.elapsed();
 		std::cout << "\nfound positions: " << pos << std::endl;
+		std::cout << "time: " << elapsed << " ms, nps: " << pos * 1000 / std::max<uint64_t>(elapsed, 1) << std::endl;
+	}
+
+	// perftsuite [max depth] [settings]
+	static void ExecutePerftSuite(std::stringstream& stream)
+	{
+		size_t maxDepth = 0;
+		if (!(stream >> maxDepth))
+			stream.clear();
+
+		if (PerftSuite(maxDepth, ReadPerftSettings(stream)))
+			std::cout << "perft suite: PASS" << std::endl;
+		else
+			std::cout << "perft suite: FAIL" << std::endl;
 	}
 
 	static void PrintCaptures() {
+		Board& board = engine.Position();
 		MoveList moves;
-		GetAllCaptures(internalBoard, internalBoard.Info(), moves);
+		GetAllCaptures(board, board.Info(), moves);
 		for (Move& move : moves) {
-			std::cout << std::to_string(move) << " " << BadCapture(internalBoard, move) << std::endl;
+			std::cout << std::to_string(move) << " " << SEE(board, move) << std::endl;
 		}
 	}
 
+	// savehash <file> / loadhash <file>, the rest of the line is the path
+	static void ExecuteHashSnapshot(std::stringstream& stream, bool save)
+	{
+		std::string path;
+		std::getline(stream >> std::ws, path);
+
+		if (path.empty())
+			std::cout << "info string no snapshot file given" << std::endl;
+		else if (save ? tpostable.saveSnapshot(path) : tpostable.loadSnapshot(path))
+			std::cout << "info string hash " << (save ? "saved to " : "loaded from ") << path << std::endl;
+		else
+			std::cout << "info string could not " << (save ? "save hash to " : "load hash from ") << path << std::endl;
+	}
+
 	static void ExecutePlay(std::stringstream& stream)
 	{
+		Board& board = engine.Position();
 		char side_char;
 		stream >> side_char;
 
 		Side mySide = side_char == 'b' ? Side::Black : Side::White;
 		bool resigned = false;
 
-		PosInfo info;
-
 		while (true) {
 			system("cls");
-			std::cout << internalBoard << std::endl;
-			info = internalBoard.Info();
+			std::cout << board << std::endl;
 
-			if (internalBoard.Turn() == mySide) {
-				Move move = Search(internalBoard, Limits());
+			if (board.Turn() == mySide) {
+				Move move = engine.Search(Limits());
 
-				if (move.origin == Square::InvalidSquare)
+				if (!move)
 					break;
 
-				internalBoard.PlayUnrecorded(move);
+				board.PlayUnrecorded(move);
 			}
 			else {
 				MoveList moves;
-				GetAllMoves(internalBoard, internalBoard.Info(), moves);
+				GetAllMoves(board, board.Info(), moves);
 
 				if (moves.size() == 0)
 					break;
@@ -161,14 +246,14 @@ namespace GGChess
 
 				for (const Move& move : moves)
 					if (std::to_string(move) == move_in)
-						internalBoard.PlayUnrecorded(move);
+						board.PlayUnrecorded(move);
 			}
 		}
 		if (!resigned) {
-			if (info.check)
+			if (board.Checkers())
 				std::cout <<
 				"Checkmate, " <<
-				std::to_string(otherside(internalBoard.Turn())) <<
+				std::to_string(otherside(board.Turn())) <<
 				" is victorious" << std::endl;
 			else
 				std::cout << "Draw" << std::endl;
@@ -193,24 +278,32 @@ namespace GGChess
 
 		if (first == "uci")
 			PrintEngineData();
+		else if (first == "setoption")
+			SetOption(stream);
 		else if (first == "isready")
 			UCI_READY;
 		else if (first == "ucinewgame")
-			internalBoard = Board();
+			engine.NewGame();
 		else if (first == "d")
-			std::cout << internalBoard << std::endl;
+			std::cout << engine.Position() << std::endl;
 		else if (first == "position")
 			ReadPosition(stream);
 		else if (first == "go")
 			ExecuteGo(stream);
 		else if (first == "perft")
 			ExecutePerft(stream);
+		else if (first == "perftsuite")
+			ExecutePerftSuite(stream);
 		else if (first == "eval")
-			std::cout << "Position evaluation: " << Evaluate(internalBoard, internalBoard.Info()) << std::endl;
+			std::cout << "Position evaluation: " << Evaluate(engine.Position()) << std::endl;
 		else if (first == "captures")
 			PrintCaptures();
 		else if (first == "info")
-			std::cout << internalBoard.Info().attackBoard << std::endl;
+			std::cout << engine.Position().AttackMap(otherside(engine.Position().Turn())) << std::endl;
+		else if (first == "savehash")
+			ExecuteHashSnapshot(stream, true);
+		else if (first == "loadhash")
+			ExecuteHashSnapshot(stream, false);
 		else if (first == "playme")
 			ExecutePlay(stream);
 	}
@@ -224,23 +317,27 @@ namespace GGChess
 			ExecuteCommand(input);
 		}
 	}
-	void printSearchData(SearchData& sdata, bool forced)
+	void printSearchData(SearchContext& ctx, bool forced)
 	{
-		static size_t prev_depth = 0;
-		static Timer timer;
+		SearchData& sdata = ctx.data;
 
-		if (!forced && prev_depth == sdata.depth && !(timer.elapsed() > 2000))
+		if (!forced && sdata.reportDepth == sdata.depth && !(sdata.reportTimer.elapsed() > 2000))
 			return;
 
-		timer.reset();
-		prev_depth = sdata.depth;
+		sdata.reportTimer.reset();
+		sdata.reportDepth = sdata.depth;
 
 		UCI_INFO << "depth " << sdata.depth <<
 			" score cp " << sdata.best.score <<
-			" nodes " << sdata.nodes <<
+			" nodes " << ctx.engine.Nodes() <<
 			" qnodes " << sdata.qnodes <<
 			" time " << sdata.timer.elapsed() <<
 			" asp_fail " << sdata.aspf <<
-			" pv " << sdata.best.myMove << std::endl;
+			" asp_window " << sdata.windowAlpha << " " << sdata.windowBeta <<
+			" pv";
+
+		for (const Move& move : sdata.pv)
+			std::cout << " " << move;
+		std::cout << std::endl;
 	}
 }
\ No newline at end of file
@@ -6,345 +6,289 @@
 #include "IO.h"
 
 #include "Board.h"
-#include "MovePatterns.h"
+#include "Attacks.h"
 
 namespace GGChess
 {
-	static SDir const knightMoves[8] = { (SDir)17, (SDir)10, (SDir)-6, (SDir)-15, (SDir)-17, (SDir)-10, (SDir)6, (SDir)15 };
-	static SDir const directions[8] = { SDir::N, SDir::NE, SDir::E, SDir::SE, SDir::S, SDir::SW, SDir::W, SDir::NW };
+	// is square attacked by a slider of the attacker with the given occupancy
+	static bool SliderAttacks(Board& board, Square square, BitBoard occupied, Side attacker)
+	{
+		BitBoard queens = board.Pieces(PieceType::Queen, attacker);
+
+		return
+			(Attacks::Bishop(square, occupied) & (board.Pieces(PieceType::Bishop, attacker) | queens)) ||
+			(Attacks::Rook(square, occupied) & (board.Pieces(PieceType::Rook, attacker) | queens));
+	}
 
-	bool AddIfLegal(Board& board, const PosInfo& info, const Move& move, MoveList& moves)
+	template<Side Us>
+	bool IsLegal(Board& board, const PosInfo& info, const Move& move)
 	{
+		constexpr Side Them = SideTraits<Us>::Them;
+
 		Square
-			epPawn = board.EPTarget() + (board.Turn() == Side::White ? SDir::S : SDir::W),
-			king = board.King(board.Turn());
-		bool kingIsMoving = move.origin == king;
+			epPawn = board.EPTarget() + SideTraits<Us>::Down,
+			king = board.King(Us);
+		bool kingIsMoving = move.origin() == king;
 
-		if (info.doubleCheck && !kingIsMoving)
-			return false;
+		if (kingIsMoving) {
+			// the king must not hide behind itself from a slider
+			BitBoard occupied = board.Occupied();
+			occupied.Set(king, false);
 
-		if (move.origin == board.King(board.Turn())) {
-			if (info.attackBoard.Get(move.target))
-				return false;
-			else {
-				moves.push_back(move);
-				return true;
-			}
+			return !IsSquareAttacked(board, move.target(), Them, occupied);
 		}
+
+		if (info.doubleCheck)
+			return false;
 		
-		if (move.flags == Move::Flags::EnPassant) {
-			uint8_t
-				abs_dr = std::abs(rankof(epPawn) - rankof(king)),
-				abs_df = std::abs(fileof(epPawn) - fileof(king));
-
-			bool diag = abs_dr == abs_df;
-
-			if (diag || abs_dr == 0) { // the king can be attacked by sliding piece behind epPawn
-				SDir dir = SDir((epPawn - king) / std::max(abs_dr, abs_df));
-				Square target = king + dir;
-				while (fileof(target) != 0 && fileof(target) != 7 && validsquare(target)) {
-					Piece tp = board[target];
-					if (tp == Piece::Empty || target == move.origin)
-						target = target + dir;
-					else if (sideof(tp) == board.Turn())
-						break;
-					else {
-						PieceType tpt = pieceof(tp);
-						if (tpt == PieceType::Queen ||
-							(tpt == PieceType::Bishop && diag) ||
-							(tpt == PieceType::Rook && !diag)) {
-							return false;
-						}
-						else
-							break;
-					}
-				}
-			}
+		if (move.flags() == Move::Flags::EnPassant) {
+			// both pawns leave the board at once, a slider behind them may see the king
+			BitBoard occupied = board.Occupied();
+			occupied.Set(move.origin(), false);
+			occupied.Set(epPawn, false);
+			occupied.Set(move.target(), true);
+
+			if (SliderAttacks(board, king, occupied, Them))
+				return false;
 		}
 
 		if (info.check) {
-			if (!info.checkBoard.Get(move.target) && // the move blocks the check
-				!(move.flags == Move::Flags::EnPassant && // the move captures en passant the checking pawn
+			if (!info.checkBoard.Get(move.target()) && // the move blocks the check
+				!(move.flags() == Move::Flags::EnPassant && // the move captures en passant the checking pawn
 					info.checkBoard.Get(epPawn)))
 				return false;
 		}
 
-		if (info.unifiedPinBoard.Get(move.origin)) {
-			for (BitBoard pin : info.pinBoards) {
-				if (!pin.Get(move.origin))
-					continue;
+		return !info.pinned.Get(move.origin()) || Attacks::Line(king, move.origin()).Get(move.target());
+	}
+
+	bool IsLegal(Board& board, const PosInfo& info, const Move& move)
+	{
+		return board.Turn() == Side::White ?
+			IsLegal<Side::White>(board, info, move) :
+			IsLegal<Side::Black>(board, info, move);
+	}
+
+	// in pseudo legal mode every move is added, the search tests them with IsLegal before playing
+	template<bool Legal, Side Us>
+	bool Add(Board& board, const PosInfo& info, const Move& move, MoveList& moves)
+	{
+		if (Legal && !IsLegal<Us>(board, info, move))
+			return false;
 
-				if (!pin.Get(move.target))
-					return false;
-				else
-					break;
-			}
-		}
 		moves.push_back(move);
 		return true;
 	}
 
-	bool IsSquareAttacked(Board& board, const PosInfo& info, Square square, Side attacker)
+	bool IsSquareAttacked(Board& board, Square square, Side attacker)
+	{
+		return IsSquareAttacked(board, square, attacker, board.Occupied());
+	}
+
+	bool IsSquareAttacked(Board& board, Square square, Side attacker, BitBoard occupied)
 	{
 		if (square == Square::InvalidSquare)
 			throw std::invalid_argument("square was invalid");
 
-		Side side = otherside(attacker);
-		bool isAttacked = false;
-
-		KnightPattern(square, [&](Square target) {
-			if (pieceof(board[target]) == PieceType::Knight && sideof(board[target]) == attacker) {
-				isAttacked = true;
-				return false;
-			}
-			return true;
-			});
-
-		PawnPattern(square, side, [&](Square target, bool attack) {
-			if (pieceof(board[target]) == PieceType::Pawn && sideof(board[target]) == attacker)
-				isAttacked = true;
-			return true;
-			}, true);
-
-		if (isAttacked)
-			return true;
-
-		SlidingPiecePattern(square, PieceType::Queen, [&](Square target, int rayIdx) {
-			Piece targetPiece = board[target];
-
-			if (targetPiece != Piece::Empty) {
-				if (sideof(targetPiece) == attacker) {
-					PieceType p = pieceof(targetPiece);
-					if( p == PieceType::Queen ||
-						(p == PieceType::Bishop && rayIdx % 2 == 1) ||
-						(p == PieceType::Rook && rayIdx % 2 == 0))
-						isAttacked = true;
-				}
-				return false;
-			}
-			return true;
-			});
-
-		SlidingPiecePattern(square, PieceType::Queen, [&](Square target, int rayIdx) {
-			Piece targetPiece = board[target];
-			if (pieceof(targetPiece) == PieceType::King && sideof(targetPiece) == attacker)
-				isAttacked = true;
-			return false;
-			});
-
-		if (isAttacked)
-			return true;
-		return false;
+		return bool(board.AttackersTo(square, occupied) & board.Pieces(attacker));
 	}
 
-	void AddWithPromotion(Board& board, const PosInfo& info, Square origin, Square target, Piece capture, MoveList& moves)
+	template<bool Legal, Side Us>
+	void AddWithPromotion(Board& board, const PosInfo& info, Square origin, Square target, bool promotion, MoveList& moves)
 	{
-		int rank = rankof(target);
-		if (rank == 7 || rank == 0) {
-			if (AddIfLegal(board, info, Move(origin, target, capture, Move::PromoteQ), moves)) {
-				moves.push_back(Move(origin, target, capture, Move::PromoteR));
-				moves.push_back(Move(origin, target, capture, Move::PromoteN));
-				moves.push_back(Move(origin, target, capture, Move::PromoteB));
+		if (promotion) {
+			if (Add<Legal, Us>(board, info, Move(origin, target, Move::PromoteQ), moves)) {
+				moves.push_back(Move(origin, target, Move::PromoteR));
+				moves.push_back(Move(origin, target, Move::PromoteN));
+				moves.push_back(Move(origin, target, Move::PromoteB));
 			}
 		}
 		else {
-			AddIfLegal(board, info, Move(origin, target, capture), moves);
+			Add<Legal, Us>(board, info, Move(origin, target), moves);
 		}
 	}
 
-	void GenerateKingMoves(Board& board, const PosInfo& info, Square square, Side side, MoveList& moves)
+	template<bool Legal, Side Us>
+	void AddTargets(Board& board, const PosInfo& info, Square origin, BitBoard targets, MoveList& moves)
 	{
-		int
-			file = fileof(square),
-			rank = rankof(square);
+		for (Square target : targets)
+			Add<Legal, Us>(board, info, Move(origin, target), moves);
+	}
 
-		int bounds[4] = { rank == 0 ? 0 : -1, rank == 7 ? 0 : 1, file == 0 ? 0 : -1, file == 7 ? 0 : 1, };
+	// targets of a non pawn piece that belong to the requested kind of moves
+	template<Side Us>
+	static BitBoard FilterTargets(Board& board, BitBoard attacks, GenType type)
+	{
+		switch (type) {
+		case GenType::Captures: return attacks & board.Pieces(SideTraits<Us>::Them);
+		case GenType::Quiets: return attacks & ~board.Occupied();
+		default: return attacks & ~board.Pieces(Us);
+		}
+	}
 
-		for (int dr = bounds[0]; dr <= bounds[1]; dr++) {
-			for (int df = bounds[2]; df <= bounds[3]; df++) { 
-				if (dr == 0 && df == 0)
-					continue;
+	template<bool Legal, Side Us>
+	void GeneratePawnMoves(Board& board, const PosInfo& info, Square square, MoveList& moves, GenType type)
+	{
+		using Traits = SideTraits<Us>;
 
-				Square target = square + SDir(dr * 8 + df);
-				Piece t = board[target];
+		Square target = square + Traits::Up;
+		bool promotion = rankof(square) == Traits::PromoteRank;
 
-				if (t != Piece::Empty && sideof(t) == side)
-					continue;
+		if (type != GenType::Quiets) {
+			BitBoard captures = Attacks::Pawn(square, Us) & board.Pieces(Traits::Them);
 
-				AddIfLegal(board, info, Move(square, target, t), moves);
-			}
-		}
+			for (Square target : captures)
+				AddWithPromotion<Legal, Us>(board, info, square, target, promotion, moves);
 
-		Side attacker = otherside(side);
-		CastleFlag
-			kingside = side == Side::White ? CastleFlag::WhiteKingside : CastleFlag::BlackKingside,
-			queenside = side == Side::White ? CastleFlag::WhiteQueenside : CastleFlag::BlackQueenside;
-
-		if (!info.check) {
-			if (board.CanCastle(kingside)) {
-				bool emptyMid =
-					board[square + 1] == Piece::Empty &&
-					board[square + 2] == Piece::Empty;
-				if (emptyMid) {
-					bool noAttack =
-						!info.attackBoard.Get(square + 1) &&
-						!info.attackBoard.Get(square + 2);
-					if (noAttack)
-						moves.push_back(Move(square, square + 2, Move::Castle));
-				}
-			}
-			if (board.CanCastle(queenside)) {
-				bool emptyMid =
-					board[square - 1] == Piece::Empty &&
-					board[square - 2] == Piece::Empty &&
-					board[square - 3] == Piece::Empty;
-				if (emptyMid) {
-					bool noAttack =
-						!info.attackBoard.Get(square - 1) &&
-						!info.attackBoard.Get(square - 2);
-					if (noAttack)
-						moves.push_back(Move(square, square - 2, Move::Castle));
-				}
-			}
+			Square ep = board.EPTarget();
+			if (ep != Square::InvalidSquare && Attacks::Pawn(square, Us).Get(ep))
+				Add<Legal, Us>(board, info, Move(square, ep, Move::EnPassant), moves);
 		}
-	}
 
-	void GetAllMoves(Board& board, const PosInfo& info, MoveList& moves)
-	{
-		for (int i = 0; i < BOARD_SQUARE_COUNT; i++) {
-			Piece p = board[(Square)i];
-			if (p != Piece::Empty && sideof(p) == board.Turn())
-				GetMoves(board, info, (Square)i, moves);
-		}
+		if (board[target] != Piece::Empty)
+			return;
+
+		// promotions are generated with the captures as they change the material
+		if (promotion ? type != GenType::Quiets : type != GenType::Captures)
+			AddWithPromotion<Legal, Us>(board, info, square, target, promotion, moves);
+
+		if (type != GenType::Captures && rankof(square) == Traits::PawnRank && board[target + Traits::Up] == Piece::Empty)
+			Add<Legal, Us>(board, info, Move(square, target + Traits::Up, Move::DoublePush), moves);
 	}
 
-	void GetAllCaptures(Board& board, const PosInfo& info, MoveList& moves)
+	template<bool Legal, Side Us>
+	void GenerateKingMoves(Board& board, const PosInfo& info, Square square, MoveList& moves, GenType type)
 	{
-		for (int i = 0; i < BOARD_SQUARE_COUNT; i++) {
-			Piece p = board[(Square)i];
-			PieceType pt = pieceof(p);
-			Side ps = sideof(p);
-
-			if (p != Piece::Empty && sideof(p) == board.Turn())
-			{
-				switch (pt) {
-				case PieceType::Pawn:
-					PawnPattern(Square(i), ps, [&](Square target, bool attack) {
-						Piece tp = board[target];
-						if (tp != Piece::Empty && sideof(tp) != ps)
-							AddWithPromotion(board, info, Square(i), target, tp, moves);
-						return true;
-						}, true);
-					break;
-				case PieceType::Knight:
-					KnightPattern(Square(i), [&](Square target) {
-						Piece tp = board[target];
-						if (tp != Piece::Empty && sideof(tp) != ps)
-							AddIfLegal(board, info, Move(Square(i), target, tp), moves);
-						return true;
-						});
-					break;
-				case PieceType::King:
-					SlidingPiecePattern(Square(i), PieceType::Queen, [&](Square target, int rayIdx) {
-						Piece tp = board[target];
-						if (tp != Piece::Empty && sideof(tp) != ps)
-							AddIfLegal(board, info, Move(Square(i), target, tp), moves);
-						return false;
-						});
-					break;
-				case PieceType::Rook:
-				case PieceType::Bishop:
-				case PieceType::Queen:
-					SlidingPiecePattern(Square(i), pt, [&](Square target, int rayIdx) {
-						Piece targetPiece = board[target];
-						if (targetPiece == Piece::Empty)
-							return true;
-						if (sideof(targetPiece) == ps)
-							return false;
-						else if (sideof(targetPiece) != ps) {
-							AddIfLegal(board, info, Move(Square(i), target, board[target]), moves);
-							return false;
-						}
-						return true;
-						});					
-					break;
-				}
+		using Traits = SideTraits<Us>;
+
+		AddTargets<Legal, Us>(board, info, square, FilterTargets<Us>(board, Attacks::King(square), type), moves);
+
+		if (type == GenType::Captures || info.check)
+			return;
+
+		if (board.CanCastle(Traits::Kingside)) {
+			bool emptyMid =
+				board[square + 1] == Piece::Empty &&
+				board[square + 2] == Piece::Empty;
+			if (emptyMid) {
+				bool noAttack =
+					!IsSquareAttacked(board, square + 1, Traits::Them) &&
+					!IsSquareAttacked(board, square + 2, Traits::Them);
+				if (noAttack)
+					moves.push_back(Move(square, square + 2, Move::Castle));
+			}
+		}
+		if (board.CanCastle(Traits::Queenside)) {
+			bool emptyMid =
+				board[square - 1] == Piece::Empty &&
+				board[square - 2] == Piece::Empty &&
+				board[square - 3] == Piece::Empty;
+			if (emptyMid) {
+				bool noAttack =
+					!IsSquareAttacked(board, square - 1, Traits::Them) &&
+					!IsSquareAttacked(board, square - 2, Traits::Them);
+				if (noAttack)
+					moves.push_back(Move(square, square - 2, Move::Castle));
 			}
 		}
-
 	}
 
-	void GetMoves(Board& board, const PosInfo& info, Square square, MoveList& moves)
+	template<bool Legal, Side Us>
+	void GeneratePieceMoves(Board& board, const PosInfo& info, Square square, MoveList& moves, GenType type)
 	{
-		Piece piece = board[square];
-		Side side = sideof(piece);
+		PieceType piece = pieceof(board[square]);
 
-		switch (pieceof(piece)) {
-		case PieceType::Pawn:
-			PawnPattern(square, side, [&](Square target, bool attack) {
-				Piece targetPiece = board[target];
-				if (attack) {
-					if (targetPiece != Piece::Empty && sideof(targetPiece) != side)
-						AddWithPromotion(board, info, square, target, targetPiece, moves);
-					else if (target == board.EPTarget())
-						AddIfLegal(board, info, Move(square, target, Move::EnPassant), moves);
-				}
-				else {
-					if (targetPiece != Piece::Empty)
-						return false;
-					if (std::abs(target - square) == 16)
-						AddIfLegal(board, info, Move(square, target, Move::DoublePush), moves);
-					else
-						AddWithPromotion(board, info, square, target, targetPiece, moves);
-				}
-				return true;
-				});
+		switch (piece) {
+		case PieceType::None:
 			break;
-		case PieceType::Knight:
-			KnightPattern(square, [&](Square target) {
-				if (board[target] == Piece::Empty || sideof(board[target]) != side)
-					AddIfLegal(board, info, Move(square, target, board[target]), moves);
-				return true;
-				});
+		case PieceType::Pawn:
+			GeneratePawnMoves<Legal, Us>(board, info, square, moves, type);
 			break;
 		case PieceType::King:
-			GenerateKingMoves(board, info, square, side, moves);
+			GenerateKingMoves<Legal, Us>(board, info, square, moves, type);
 			break;
-		case PieceType::Rook:
-		case PieceType::Bishop:
-		case PieceType::Queen:
-			Side side = sideof(piece);
-
-			SlidingPiecePattern(square, pieceof(piece), [&](Square target, int rayIdx) {
-				Piece targetPiece = board[target];
-
-				if (targetPiece == Piece::Empty)
-					AddIfLegal(board, info, Move(square, target), moves);
-				else if (sideof(targetPiece) == side)
-					return false;
-				else if (sideof(targetPiece) != side) {
-					AddIfLegal(board, info, Move(square, target, board[target]), moves);
-					return false;
-				}
-				return true;
-				});
+		default:
+			AddTargets<Legal, Us>(board, info, square, FilterTargets<Us>(board, Attacks::Of(piece, square, board.Occupied()), type), moves);
 			break;
 		}
 	}
 
-	size_t Perft(size_t depth, Board& board) {
-		if (depth == 0)
-			return 1;
+	template<bool Legal, Side Us>
+	void Generate(Board& board, const PosInfo& info, MoveList& moves, GenType type)
+	{
+		// only the king can answer a double check
+		if (!info.doubleCheck) {
+			for (Square square : board.Pieces(PieceType::Pawn, Us))
+				GeneratePawnMoves<Legal, Us>(board, info, square, moves, type);
+
+			for (PieceType piece : { PieceType::Knight, PieceType::Bishop, PieceType::Rook, PieceType::Queen })
+				for (Square square : board.Pieces(piece, Us))
+					AddTargets<Legal, Us>(board, info, square, FilterTargets<Us>(board, Attacks::Of(piece, square, board.Occupied()), type), moves);
+		}
+
+		GenerateKingMoves<Legal, Us>(board, info, board.King(Us), moves, type);
+	}
 
-		MoveList moves;
-		GetAllMoves(board, board.Info(), moves);
-		size_t pos = 0;
+	// the side is resolved once here, everything below is compiled for a fixed side
+	template<bool Legal>
+	void Generate(Board& board, const PosInfo& info, MoveList& moves, GenType type)
+	{
+		if (board.Turn() == Side::White)
+			Generate<Legal, Side::White>(board, info, moves, type);
+		else
+			Generate<Legal, Side::Black>(board, info, moves, type);
+	}
 
-		for (Move& move : moves) {
-			board.PlayMove(move);
-			pos += Perft(depth - 1, board);
-			board.UnplayMove();
+	template<bool Legal>
+	void GeneratePieceMoves(Board& board, const PosInfo& info, Square square, MoveList& moves, GenType type)
+	{
+		if (sideof(board[square]) == Side::White)
+			GeneratePieceMoves<Legal, Side::White>(board, info, square, moves, type);
+		else
+			GeneratePieceMoves<Legal, Side::Black>(board, info, square, moves, type);
+	}
+
+	void GetAllMoves(Board& board, const PosInfo& info, MoveList& moves)
+	{
+		Generate<true>(board, info, moves, GenType::All);
+	}
+
+	void GetAllCaptures(Board& board, const PosInfo& info, MoveList& moves)
+	{
+		Generate<true>(board, info, moves, GenType::Captures);
+	}
+
+	void GetAllQuiets(Board& board, const PosInfo& info, MoveList& moves)
+	{
+		Generate<true>(board, info, moves, GenType::Quiets);
+	}
+
+	void GetMoves(Board& board, const PosInfo& info, Square square, MoveList& moves, GenType type)
+	{
+		GeneratePieceMoves<true>(board, info, square, moves, type);
+	}
+
+	void GetPseudoMoves(Board& board, const PosInfo& info, MoveList& moves, GenType type)
+	{
+		Generate<false>(board, info, moves, type);
+	}
+
+	bool IsPseudoLegal(Board& board, const PosInfo& info, const Move& move)
+	{
+		if (!move)
+			return false;
+
+		Piece piece = board[move.origin()];
+		if (piece == Piece::Empty || sideof(piece) != board.Turn())
+			return false;
+
+		MoveList pieceMoves;
+		GeneratePieceMoves<false>(board, info, move.origin(), pieceMoves, GenType::All);
+
+		for (const Move& candidate : pieceMoves) {
+			if (candidate == move)
+				return true;
 		}
-		return pos;
+		return false;
 	}
 }
\ No newline at end of file
@@ -0,0 +1,189 @@
+#include "MovePicker.h"
+
+#include <algorithm>
+
+#include "Search.h"
+
+namespace GGChess
+{
+	void MoveHistory::clear()
+	{
+		std::fill_n(&butterfly[0][0][0], sizeof(butterfly) / sizeof(int16_t), 0);
+		std::fill_n(&continuation[0][0][0][0], sizeof(continuation) / sizeof(int16_t), 0);
+		std::fill_n(&captures[0][0][0], sizeof(captures) / sizeof(int16_t), 0);
+		std::fill_n(&counters[0][0], sizeof(counters) / sizeof(Move), Move());
+	}
+
+	int MoveHistory::quietScore(Side side, Piece piece, const Move& move, const PieceToHistory* const continuation[2]) const
+	{
+		size_t pieceIdx = PieceIndex(piece);
+		int score = butterfly[side == Side::Black][move.origin()][move.target()];
+
+		for (size_t i = 0; i < 2; i++) {
+			if (continuation[i])
+				score += (*continuation[i])[pieceIdx][move.target()];
+		}
+		return score;
+	}
+
+	MovePicker::MovePicker(Board& board, const Move& ttMove, const Move killers[2], const Move& counter,
+		const MoveHistory& history, const PieceToHistory* const continuation[2]) :
+		board(board), info(board.Info()), stage(Stage::TTMove),
+		ttMove(ttMove), killers{ killers[0], killers[1] }, killerIdx(0), counter(counter),
+		history(&history), continuation{ continuation[0], continuation[1] },
+		moves(), badCaptures(), current(0)
+	{}
+
+	MovePicker::MovePicker(Board& board) :
+		board(board), info(board.Info()), stage(Stage::QGenCaptures),
+		ttMove(), killers{}, killerIdx(0), counter(),
+		history(nullptr), continuation{},
+		moves(), badCaptures(), current(0)
+	{}
+
+	const PosInfo& MovePicker::Info() const {
+		return info;
+	}
+
+	Move MovePicker::next()
+	{
+		switch (stage) {
+		case Stage::TTMove:
+			stage = Stage::GenCaptures;
+			if (IsPseudoLegal(board, info, ttMove))
+				return ttMove;
+			ttMove = Move();
+			[[fallthrough]];
+
+		case Stage::GenCaptures:
+			GetPseudoMoves(board, info, moves, GenType::Captures);
+			scoreCaptures();
+			stage = Stage::GoodCaptures;
+			[[fallthrough]];
+
+		case Stage::GoodCaptures:
+			while (current < moves.size()) {
+				Move move = pickBest();
+
+				if (move == ttMove)
+					continue;
+
+				if (SEE(board, move) < 0) {
+					badCaptures.push_back(move);
+					continue;
+				}
+				return move;
+			}
+			stage = Stage::Killers;
+			[[fallthrough]];
+
+		case Stage::Killers:
+			while (killerIdx < 2) {
+				Move& killer = killers[killerIdx++];
+
+				bool quiet = killer && board[killer.target()] == Piece::Empty;
+
+				if (quiet && killer != ttMove && IsPseudoLegal(board, info, killer))
+					return killer;
+				killer = Move();
+			}
+			stage = Stage::CounterMove;
+			[[fallthrough]];
+
+		case Stage::CounterMove:
+			stage = Stage::GenQuiets;
+			if (counter && board[counter.target()] == Piece::Empty &&
+				counter != ttMove && counter != killers[0] && counter != killers[1] &&
+				IsPseudoLegal(board, info, counter))
+				return counter;
+			counter = Move();
+			[[fallthrough]];
+
+		case Stage::GenQuiets:
+			moves.clear();
+			current = 0;
+			GetPseudoMoves(board, info, moves, GenType::Quiets);
+			scoreQuiets();
+			stage = Stage::Quiets;
+			[[fallthrough]];
+
+		case Stage::Quiets:
+			while (current < moves.size()) {
+				Move move = pickBest();
+
+				if (move == ttMove || move == killers[0] || move == killers[1] || move == counter)
+					continue;
+				return move;
+			}
+			current = 0;
+			stage = Stage::BadCaptures;
+			[[fallthrough]];
+
+		case Stage::BadCaptures:
+			if (current < badCaptures.size())
+				return badCaptures[current++];
+			stage = Stage::Done;
+			return Move();
+
+		case Stage::QGenCaptures:
+			GetPseudoMoves(board, info, moves, GenType::Captures);
+			scoreCaptures();
+			stage = Stage::QCaptures;
+			[[fallthrough]];
+
+		case Stage::QCaptures:
+			if (current < moves.size())
+				return pickBest();
+			stage = Stage::Done;
+			[[fallthrough]];
+
+		case Stage::Done:
+			break;
+		}
+		return Move();
+	}
+
+	void MovePicker::scoreCaptures()
+	{
+		for (size_t i = 0; i < moves.size(); i++) {
+			const Move& move = moves[i];
+			scores[i] = 0;
+
+			Piece captured = board[move.target()];
+
+			if (captured != Piece::Empty)
+				scores[i] += 10 * valueof(captured) - valueof(board[move.origin()]);
+			else if (move.flags() == Move::Flags::EnPassant)
+				scores[i] += 9 * valueof(PieceType::Pawn);
+
+			if (move.isPromotion())
+				scores[i] += valueof(move.promotion());
+
+			// the history only breaks ties between captures of similar value
+			if (history)
+				scores[i] += history->captures[PieceIndex(board[move.origin()])][move.target()][uint8_t(pieceof(board.Captured(move)))] / 16;
+		}
+	}
+
+	void MovePicker::scoreQuiets()
+	{
+		for (size_t i = 0; i < moves.size(); i++) {
+			const Move& move = moves[i];
+			scores[i] = history->quietScore(board.Turn(), board[move.origin()], move, continuation);
+		}
+	}
+
+	// selection sort step: swaps the best remaining move to the front and returns it
+	Move MovePicker::pickBest()
+	{
+		size_t best = current;
+		for (size_t i = current + 1; i < moves.size(); i++) {
+			if (scores[i] > scores[best])
+				best = i;
+		}
+
+		std::swap(moves[current], moves[best]);
+		std::swap(scores[current], scores[best]);
+		return moves[current++];
+	}
+}
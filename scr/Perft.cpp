@@ -0,0 +1,242 @@
+#include "Perft.h"
+
+#include <future>
+#include <iostream>
+#include <iomanip>
+
+#include "Board.h"
+#include "Fen.h"
+#include "MoveGenerator.h"
+#include "ThreadPool.h"
+
+namespace GGChess
+{
+	PerftTable::PerftTable(size_t sizeMB) :
+		table(), mask(0)
+	{
+		size_t count = 1;
+		while (count * 2 * sizeof(Entry) <= sizeMB * 1024 * 1024)
+			count *= 2;
+
+		table = std::make_unique<Entry[]>(count);
+		mask = count - 1;
+	}
+
+	// the same position is stored separately for every depth
+	static inline size_t PerftIndex(ZobristKey key, size_t depth) {
+		return size_t(key ^ (depth * 0x9E3779B97F4A7C15ULL));
+	}
+
+	bool PerftTable::probe(ZobristKey key, size_t depth, uint64_t& nodes) const
+	{
+		const Entry& entry = table[PerftIndex(key, depth) & mask];
+		uint64_t
+			check = entry.check.load(std::memory_order_relaxed),
+			data = entry.data.load(std::memory_order_relaxed);
+
+		if ((check ^ data) != key || (data & 0xFF) != depth)
+			return false;
+
+		nodes = data >> 8;
+		return true;
+	}
+
+	void PerftTable::save(ZobristKey key, size_t depth, uint64_t nodes)
+	{
+		Entry& entry = table[PerftIndex(key, depth) & mask];
+		uint64_t data = nodes << 8 | depth;
+
+		entry.check.store(key ^ data, std::memory_order_relaxed);
+		entry.data.store(data, std::memory_order_relaxed);
+	}
+
+	PerftSettings::PerftSettings() :
+		threads(std::thread::hardware_concurrency()), hashMB(64), copyMake(false)
+	{}
+
+	uint64_t Perft(size_t depth, Board& board)
+	{
+		return Perft(depth, board, nullptr);
+	}
+
+	uint64_t Perft(size_t depth, Board& board, PerftTable* table)
+	{
+		if (depth == 0)
+			return 1;
+
+		uint64_t nodes = 0;
+		if (depth > 1 && table && table->probe(board.Key(), depth, nodes))
+			return nodes;
+
+		MoveList moves;
+		GetAllMoves(board, board.Info(), moves);
+
+		if (depth == 1)
+			return moves.size();
+
+		for (const Move& move : moves) {
+			board.PlayMove(move);
+			nodes += Perft(depth - 1, board, table);
+			board.UnplayMove();
+		}
+
+		if (table)
+			table->save(board.Key(), depth, nodes);
+		return nodes;
+	}
+
+	uint64_t PerftCopy(size_t depth, Board& board)
+	{
+		if (depth == 0)
+			return 1;
+
+		MoveList moves;
+		GetAllMoves(board, board.Info(), moves);
+
+		if (depth == 1)
+			return moves.size();
+
+		uint64_t nodes = 0;
+		for (const Move& move : moves) {
+			Board child = board;
+			child.PlayUnrecorded(move);
+			nodes += PerftCopy(depth - 1, child);
+		}
+		return nodes;
+	}
+
+	std::vector<PerftResult> PerftDivide(size_t depth, Board& board, const PerftSettings& settings)
+	{
+		std::vector<PerftResult> results;
+		if (depth == 0)
+			return results;
+
+		MoveList moves;
+		GetAllMoves(board, board.Info(), moves);
+
+		std::unique_ptr<PerftTable> table;
+		if (settings.hashMB && !settings.copyMake)
+			table = std::make_unique<PerftTable>(settings.hashMB);
+
+		ThreadPool pool(settings.threads);
+		std::vector<std::future<uint64_t>> counts;
+
+		// every task works on its own copy of the board
+		for (const Move& move : moves) {
+			counts.push_back(pool.submit([&board, &settings, &table, move, depth]() {
+				Board child = board;
+
+				if (settings.copyMake) {
+					child.PlayUnrecorded(move);
+					return PerftCopy(depth - 1, child);
+				}
+				child.PlayMove(move);
+				return Perft(depth - 1, child, table.get());
+			}));
+		}
+
+		for (size_t i = 0; i < moves.size(); i++)
+			results.push_back({ moves[i], counts[i].get() });
+
+		return results;
+	}
+
+	struct PerftPosition
+	{
+		const char* name;
+		const char* fen;
+		std::vector<uint64_t> counts; // leaf counts from depth 1
+	};
+
+	static const PerftPosition suite[] = {
+		{ "startpos", "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+			{ 20, 400, 8902, 197281, 4865609, 119060324 } },
+		{ "kiwipete", "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+			{ 48, 2039, 97862, 4085603, 193690690 } },
+		{ "position 3", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+			{ 14, 191, 2812, 43238, 674624, 11030083, 178633661 } },
+		{ "position 4", "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+			{ 6, 264, 9467, 422333, 15833292 } },
+		{ "position 4 mirrored", "r2q1rk1/pP1p2pp/Q4n2/bbp1p3/Np6/1B3NBn/pPPP1PPP/R3K2R b KQ - 0 1",
+			{ 6, 264, 9467, 422333, 15833292 } },
+		{ "position 5", "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+			{ 44, 1486, 62379, 2103487, 89941194 } },
+		{ "position 6", "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+			{ 46, 2079, 89890, 3894594, 164075551 } },
+		{ "illegal e.p. 1", "3k4/3p4/8/K1P4r/8/8/8/8 b - - 0 1",
+			{ 18, 92, 1670, 10138, 185429, 1134888 } },
+		{ "illegal e.p. 2", "8/8/4k3/8/2p5/8/B2P2K1/8 w - - 0 1",
+			{ 13, 102, 1266, 10276, 135655, 1015133 } },
+		{ "e.p. gives check", "8/8/1k6/2b5/2pP4/8/5K2/8 b - d3 0 1",
+			{ 15, 126, 1928, 13931, 206379, 1440467 } },
+		{ "short castle gives check", "5k2/8/8/8/8/8/8/4K2R w K - 0 1",
+			{ 15, 66, 1198, 6399, 120330, 661072 } },
+		{ "long castle gives check", "3k4/8/8/8/8/8/8/R3K3 w Q - 0 1",
+			{ 16, 71, 1286, 7418, 141077, 803711 } },
+		{ "castling rights", "r3k2r/1b4bq/8/8/8/8/7B/R3K2R w KQkq - 0 1",
+			{ 26, 1141, 27826, 1274206 } },
+		{ "castling prevented", "r3k2r/8/3Q4/8/8/5q2/8/R3K2R b KQkq - 0 1",
+			{ 44, 1494, 50509, 1720476 } },
+		{ "promote out of check", "2K2r2/4P3/8/8/8/8/8/3k4 w - - 0 1",
+			{ 11, 133, 1442, 19174, 266199, 3821001 } },
+		{ "discovered check", "8/8/1P2K3/8/2n5/1q6/8/5k2 b - - 0 1",
+			{ 29, 165, 5160, 31961, 1004658 } },
+		{ "promote to give check", "4k3/1P6/8/8/8/8/K7/8 w - - 0 1",
+			{ 9, 40, 472, 2661, 38983, 217342 } },
+		{ "underpromote to check", "8/P1k5/K7/8/8/8/8/8 w - - 0 1",
+			{ 6, 27, 273, 1329, 18135, 92683 } },
+		{ "self stalemate", "K1k5/8/P7/8/8/8/8/8 w - - 0 1",
+			{ 2, 6, 13, 63, 382, 2217 } },
+		{ "stalemate and checkmate", "8/k1P5/8/1K6/8/8/8/8 w - - 0 1",
+			{ 10, 25, 268, 926, 10857, 43261, 567584 } },
+		{ "double check", "8/8/2k5/5q2/5n2/8/5K2/8 b - - 0 1",
+			{ 37, 183, 6559, 23527 } },
+	};
+
+	bool PerftSuite(size_t maxDepth, const PerftSettings& settings)
+	{
+		size_t failures = 0;
+		uint64_t totalNodes = 0, totalTime = 0;
+
+		for (const PerftPosition& position : suite) {
+			size_t depth = position.counts.size();
+			if (maxDepth)
+				depth = std::min(depth, maxDepth);
+
+			Board board;
+			Fen::Set(board, std::string(position.fen));
+			board.SetThisAsStart();
+
+			Timer timer;
+			uint64_t nodes = 0;
+			for (const PerftResult& result : PerftDivide(depth, board, settings))
+				nodes += result.nodes;
+
+			uint64_t
+				elapsed = timer.elapsed(),
+				expected = position.counts[depth - 1];
+			bool ok = nodes == expected;
+
+			totalNodes += nodes;
+			totalTime += elapsed;
+			failures += !ok;
+
+			std::cout << std::left << std::setw(26) << position.name << " depth " << depth
+				<< std::right << std::setw(12) << nodes << std::setw(8) << elapsed << " ms"
+				<< std::setw(12) << nodes * 1000 / std::max<uint64_t>(elapsed, 1) << " nps";
+
+			if (ok)
+				std::cout << "  ok" << std::endl;
+			else
+				std::cout << "  FAILED, expected " << expected << std::endl;
+		}
+
+		std::cout << "total " << totalNodes << " nodes in " << totalTime << " ms, "
+			<< totalNodes * 1000 / std::max<uint64_t>(totalTime, 1) << " nps" << std::endl;
+
+		if (failures)
+			std::cout << failures << " position(s) gave wrong counts" << std::endl;
+
+		return !failures;
+	}
+}
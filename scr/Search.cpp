@@ -3,16 +3,18 @@
 #include <stdexcept>
 #include <limits>
 #include <algorithm>
+#include <cmath>
 
 #include <iostream>
 #include "IO.h"
 
 #include "Board.h"
 #include "MoveGenerator.h"
-#include "ThreadPool.h"
-#include "MovePatterns.h"
+#include "MovePicker.h"
+#include "Attacks.h"
 #include "TransposTable.h"
 #include "InputHandler.h"
+#include "Engine.h"
 
 namespace GGChess
 {
@@ -21,7 +23,11 @@ namespace GGChess
 		nodes = 0;
 		qnodes = 0;
 		aspf = 0;
+		depth = 0;
+		pv.clear();
+		reportDepth = 0;
 		timer.reset();
+		reportTimer.reset();
 	}
 
 	void SearchData::allocTime(Limits limits, Board& board)
@@ -40,22 +46,33 @@ namespace GGChess
 		}
 	}
 
-	bool SearchData::timeout() {
-		return movetime < timer.elapsed();
+	SearchContext::SearchContext(Engine& engine, size_t threadIdx) :
+		engine(engine), threadIdx(threadIdx),
+		board(), data(), history(), stack{}, pv{}, pvLength{}
+	{}
+
+	bool SearchContext::isMain() const {
+		return threadIdx == 0;
 	}
 
-	SearchData sdata;
+	bool SearchContext::timeout() {
+		return engine.Stopped() || data.movetime < data.timer.elapsed();
+	}
 
-	static std::array<uint8_t, TABLE_SIZE> prevPosTable; // TODO Rewrite this mess
+	// plain load and store, the counter has a single writer
+	static inline void Increment(std::atomic<uint64_t>& counter) {
+		counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	}
 
+	// scores have to fit the 16 bits of a transposition table entry
 	const Value
-		MAX_VALUE = std::numeric_limits<Value>::max() / 2,
-		MIN_VALUE = (std::numeric_limits<Value>::min() + 1) / 2;
+		MAX_VALUE = 32000,
+		MIN_VALUE = -MAX_VALUE;
 
 	const int phaseInc[7] = { 0, 0, 4, 1, 1, 2, 0 };
 
 	RootMove::RootMove() :
-		myMove(Square(100), Square(100)),
+		myMove(),
 		score(MIN_VALUE)
 	{}
 
@@ -72,120 +89,103 @@ namespace GGChess
 		return square ^ 56;
 	}
 
-	static void OrderMoves(Board& board, MoveList& moves)
+	// least valuable piece of side among the attackers, InvalidSquare when there is none
+	static inline Square LeastValuableAttacker(const Board& board, BitBoard attackers, Side side, PieceType& type)
 	{
-		if (moves.size() < 2)
-			return;
+		static const PieceType order[] = {
+			PieceType::Pawn, PieceType::Knight, PieceType::Bishop, PieceType::Rook, PieceType::Queen, PieceType::King
+		};
+
+		for (PieceType piece : order) {
+			BitBoard candidates = attackers & board.Pieces(piece, side);
+			if (candidates) {
+				type = piece;
+				return candidates.lsb();
+			}
+		}
+		return Square::InvalidSquare;
+	}
 
-		std::vector<Value> scores(moves.size());
+	Value SEE(const Board& board, const Move& move)
+	{
+		Square
+			origin = move.origin(),
+			target = move.target();
 
-		for (size_t i = 0; i < moves.size(); i++) {
-			scores[i] = 0;
-			const Move& move = moves[i];
+		Value gain[32];
+		int d = 0;
 
-			if (move.captured != Piece::Empty) {
-				scores[i] +=
-					10 * valueof(move.captured) -
-					valueof(board[move.origin]);
-			}
+		BitBoard occupied = board.Occupied();
+		BitBoard
+			diagonal = board.Pieces(PieceType::Bishop) | board.Pieces(PieceType::Queen),
+			straight = board.Pieces(PieceType::Rook) | board.Pieces(PieceType::Queen);
 
-			if (move.flags & Move::Flags::Promotion) {
-				switch (move.flags) {
-				case Move::Flags::PromoteQ: scores[i] += valueof(PieceType::Queen); break;
-				case Move::Flags::PromoteR: scores[i] += valueof(PieceType::Rook); break;
-				case Move::Flags::PromoteN: scores[i] += valueof(PieceType::Knight); break;
-				case Move::Flags::PromoteB: scores[i] += valueof(PieceType::Bishop); break;
-				}
-			}
-		}
+		PieceType attacker = pieceof(board[origin]);
+		gain[0] = valueof(board.Captured(move));
 
-		for (size_t i = 0; i < moves.size() - 1; i++) {
-			for (size_t j = i + 1; j > 0; j--) {
-				size_t swapIndex = j - 1;
-				if (scores[swapIndex] < scores[j]) {
-					Move mtemp = moves[j];
-					moves[j] = moves[swapIndex];
-					moves[swapIndex] = mtemp;
-
-					Value stemp = scores[j];
-					scores[j] = scores[swapIndex];
-					scores[swapIndex] = stemp;
-				}
-			}
+		if (move.isPromotion()) {
+			attacker = move.promotion();
+			gain[0] += valueof(attacker) - valueof(PieceType::Pawn);
 		}
-	}
 
-	bool BadCapture(Board& board, Move& move)
-	{
-		Piece moving = board[move.origin];
-		PieceType
-			mt = pieceof(moving),
-			ct = pieceof(move.captured);
-
-		if (pieceof(moving) == PieceType::Pawn)
-			return false;
-
-		if (valueof(mt) - 50 <= valueof(ct))
-			return false;
-
-		bool defendedByPawn = false;
-		PawnPattern(move.target, sideof(moving), [&](Square target, bool attack) {
-			Piece tp = board[target];
-			if (pieceof(tp) == PieceType::Pawn && sideof(tp) != sideof(moving))
-				defendedByPawn = true;
-			return true;
-			}, true);
-
-		if (defendedByPawn && valueof(ct) + 200 < valueof(mt))
-			return true;
-
-		if (valueof(ct) + 500 < valueof(mt)) {
-			bool isAttacked = false;
-
-			KnightPattern(move.target, [&](Square target) {
-				if (pieceof(board[target]) == PieceType::Knight && sideof(board[target]) == sideof(move.captured)) {
-					isAttacked = true;
-					return false;
-				}
-				return true;
-				});
+		if (move.flags() == Move::Flags::EnPassant)
+			occupied.Set(Square(rankof(origin) * 8 + fileof(target)), false);
 
-			SlidingPiecePattern(move.target, PieceType::Bishop, [&](Square target, int rayIdx) {
-				Piece targetPiece = board[target];
+		occupied.Set(origin, false);
+		BitBoard attackers = board.AttackersTo(target, occupied) & occupied;
+		Side side = otherside(sideof(board[origin]));
 
-				if (isAttacked)
-					return false;
+		// every step stores what the side to move wins if it recaptures and loses the recapturing piece
+		while (d < 31) {
+			PieceType type;
+			Square square = LeastValuableAttacker(board, attackers, side, type);
+			if (square == Square::InvalidSquare)
+				break;
 
-				if (targetPiece != Piece::Empty) {
-					if (sideof(targetPiece) == sideof(move.captured) && pieceof(targetPiece) == PieceType::Bishop) {
-						isAttacked = true;
-					}
-					return false;
-				}
-				return true;
-				});
+			// the king may only take the last piece standing
+			if (type == PieceType::King && (attackers & board.Pieces(otherside(side))))
+				break;
 
-			if (isAttacked)
-				return true;
+			d++;
+			gain[d] = valueof(attacker) - gain[d - 1];
+
+			// the result cannot change sign any more, the last speculative step is left out
+			if (std::max(-gain[d - 1], gain[d]) < 0) {
+				d--;
+				break;
+			}
+
+			// the piece behind the recapturing one may join in on the same line
+			occupied.Set(square, false);
+			attackers |= (Attacks::Bishop(target, occupied) & diagonal) | (Attacks::Rook(target, occupied) & straight);
+			attackers &= occupied;
+
+			attacker = type;
+			side = otherside(side);
 		}
 
-		return false;
+		// either side may stop capturing when going on would lose more
+		while (d > 0) {
+			gain[d - 1] = -std::max(-gain[d - 1], gain[d]);
+			d--;
+		}
+		return gain[0];
 	}
 
-	size_t quiesce_count = 0;
-
-	static Value QuiesceSearch(Board& board, const PosInfo& info, Value alpha, Value beta)
+	static Value QuiesceSearch(SearchContext& ctx, Value alpha, Value beta)
 	{
-		if (sdata.timeout())
+		Board& board = ctx.board;
+
+		if (ctx.timeout())
 			return 0; // abort search
 
-		sdata.nodes++;
-		sdata.qnodes++;
-		quiesce_count++;
+		Increment(ctx.data.nodes);
+		Increment(ctx.data.qnodes);
 
-		printSearchData(sdata);
+		if (ctx.isMain())
+			printSearchData(ctx);
 		
-		Value eval = Evaluate(board, info);
+		Value eval = Evaluate(board);
 		Value standPat = eval;
 
 		if (eval >= beta)
@@ -194,22 +194,22 @@ namespace GGChess
 		if (alpha < eval)
 			alpha = eval;
 
-		MoveList moves;
-		GetAllCaptures(board, info, moves);
-		OrderMoves(board, moves);
+		MovePicker picker(board);
 
-		for (Move& move : moves) {
-			if (standPat + valueof(pieceof(move.captured)) + 200 < alpha &&
-				!(move.flags & Move::Flags::Promotion)) // TODO endgame material check
+		for (Move move = picker.next(); move; move = picker.next()) {
+			if (!IsLegal(board, picker.Info(), move))
 				continue;
 
-			if (BadCapture(board, move) &&
-				pieceof(move.captured) != PieceType::Pawn && // TODO can simplify
-				!(move.flags & Move::Flags::Promotion))
+			if (standPat + valueof(board[move.target()]) + 200 < alpha &&
+				!move.isPromotion()) // TODO endgame material check
+				continue;
+
+			// losing exchanges cannot lift the score above the stand pat
+			if (!move.isPromotion() && SEE(board, move) < 0)
 				continue;
 
 			board.PlayMove(move);
-			eval = -QuiesceSearch(board, board.Info(), -beta, -alpha);
+			eval = -QuiesceSearch(ctx, -beta, -alpha);
 			board.UnplayMove();
 
 			if (eval > alpha) {
@@ -221,64 +221,330 @@ namespace GGChess
 		return alpha;
 	}
 
-	static Value SearchHelper(Board& board, const PosInfo& info, int depth, Value alpha, Value beta)
+	// the best line from ply starts with move and continues with the line found from ply + 1
+	static inline void UpdatePV(SearchContext& ctx, int ply, const Move& move)
 	{
-		if (sdata.timeout())
+		ctx.pv[ply][ply] = move;
+		for (size_t i = ply + 1; i < ctx.pvLength[ply + 1]; i++)
+			ctx.pv[ply][i] = ctx.pv[ply + 1][i];
+		ctx.pvLength[ply] = std::max<size_t>(ctx.pvLength[ply + 1], ply + 1);
+	}
+
+	// continuation tables of the moves one and two plies back
+	static inline void GetContinuation(SearchContext& ctx, int ply, PieceToHistory* continuation[2])
+	{
+		for (int i = 0; i < 2; i++) {
+			continuation[i] = nullptr;
+			if (ply > i && ctx.stack[ply - 1 - i].move) {
+				const SearchContext::StackEntry& prev = ctx.stack[ply - 1 - i];
+				continuation[i] = &ctx.history.continuation[PieceIndex(prev.piece)][prev.move.target()];
+			}
+		}
+	}
+
+	static inline int StatBonus(int depth) {
+		return std::min(32 * depth * depth + 64 * depth, 2000);
+	}
+
+	// rewards the move that caused the cutoff, punishes the moves of its kind searched before it
+	static void UpdateStats(SearchContext& ctx, int ply, int depth, const Move& best, bool quiet,
+		PieceToHistory* const continuation[2], MoveList& quietsTried, MoveList& capturesTried)
+	{
+		Board& board = ctx.board;
+		MoveHistory& history = ctx.history;
+		size_t side = board.Turn() == Side::Black;
+		int bonus = StatBonus(depth);
+
+		auto updateQuiet = [&](const Move& move, int bonus) {
+			size_t pieceIdx = PieceIndex(board[move.origin()]);
+			UpdateHistory(history.butterfly[side][move.origin()][move.target()], bonus);
+			for (size_t i = 0; i < 2; i++) {
+				if (continuation[i])
+					UpdateHistory((*continuation[i])[pieceIdx][move.target()], bonus);
+			}
+		};
+
+		auto updateCapture = [&](const Move& move, int bonus) {
+			Piece captured = board.Captured(move);
+			UpdateHistory(history.captures[PieceIndex(board[move.origin()])][move.target()][uint8_t(pieceof(captured))], bonus);
+		};
+
+		if (quiet) {
+			if (best != ctx.stack[ply].killers[0]) {
+				ctx.stack[ply].killers[1] = ctx.stack[ply].killers[0];
+				ctx.stack[ply].killers[0] = best;
+			}
+
+			if (ply > 0 && ctx.stack[ply - 1].move) {
+				const SearchContext::StackEntry& prev = ctx.stack[ply - 1];
+				history.counters[PieceIndex(prev.piece)][prev.move.target()] = best;
+			}
+
+			updateQuiet(best, bonus);
+			for (const Move& move : quietsTried)
+				updateQuiet(move, -bonus);
+		}
+		else {
+			updateCapture(best, bonus);
+		}
+
+		// a capture that did not cut is worse than the history said, whatever the best move was
+		for (const Move& move : capturesTried)
+			updateCapture(move, -bonus);
+	}
+
+	// late move reductions by depth and move number, both grow the reduction logarithmically
+	static const auto reductions = []() {
+		std::array<std::array<int, MAX_MOVES>, MAX_DEPTH> table{};
+		for (size_t depth = 1; depth < MAX_DEPTH; depth++) {
+			for (size_t moveCount = 1; moveCount < MAX_MOVES; moveCount++)
+				table[depth][moveCount] = int(0.75 + std::log(double(depth)) * std::log(double(moveCount)) / 2.25);
+		}
+		return table;
+	}();
+
+	// quiet moves searched before the rest are pruned at low depth, fewer when the eval is falling
+	static inline size_t LMPLimit(int depth, bool improving) {
+		return improving ? 3 + depth * depth : (3 + depth * depth) / 2;
+	}
+
+	static inline Value FutilityMargin(int depth) {
+		return 80 * depth;
+	}
+
+	static inline Value RazorMargin(int depth) {
+		return 300 * depth;
+	}
+
+	// half width of the first aspiration window
+	static const Value ASPIRATION_DELTA = 15;
+
+	static inline Value SEEQuietMargin(int depth) {
+		return 60 * depth;
+	}
+
+	static Value SearchHelper(SearchContext& ctx, int depth, int ply, Value alpha, Value beta, bool allowNull = true)
+	{
+		Board& board = ctx.board;
+		bool pvNode = beta - alpha > 1;
+
+		ctx.pvLength[ply] = ply;
+
+		if (ctx.timeout())
 			return 0; // abort search
 
+		if (ply >= int(MAX_DEPTH) - 1)
+			return Evaluate(board);
+
 		tpostable.prefetch(board.Key());
 
-		prevPosTable.at(board.Key() % TABLE_SIZE)++; // TODO better repetition test
+		if (board.IsDraw(ply))
+			return 0;
+
+		bool check = bool(board.Checkers());
 
-		if (info.check && depth <= 0) // Do not evaluate when in check to prevent false result
+		// fifty move rule in check, IsDraw leaves it here: a draw unless the side to move is mated
+		if (check && board.HalfMove() >= 100) {
+			MoveList moves;
+			GetAllMoves(board, board.Info(), moves);
+			return moves.size() ? 0 : MIN_VALUE + 1;
+		}
+
+		if (check && depth <= 0) // Do not evaluate when in check to prevent false result, checks past the extension budget end up here
 			depth++;
 
-		printSearchData(sdata);
+		if (ctx.isMain())
+			printSearchData(ctx);
 
-		if (depth <= 0) {
-			return QuiesceSearch(board, info, alpha, beta); // search until no capture
-			//quiesce_count = 0;
-		}
+		if (depth <= 0)
+			return QuiesceSearch(ctx, alpha, beta); // search until no capture
 
-		sdata.nodes++;
+		Increment(ctx.data.nodes);
+
+		SearchContext::StackEntry& ss = ctx.stack[ply];
+		bool excluded = bool(ss.excluded); // the table holds the node with all of its moves
 
 		TTEntry ttentry;
-		if (tpostable.probe(board.Key(), depth, alpha, beta, ttentry))
-			return ttentry.eval; // TODO when pv node
+		if (tpostable.probe(board.Key(), depth, alpha, beta, ttentry) && !pvNode && !excluded)
+			return ttentry.eval; // pv nodes are searched to get the whole line
 
-		MoveList moves;
-		GetAllMoves(board, info, moves);
+		ss.staticEval = check ? MIN_VALUE : Evaluate(board);
+		ss.improving = !check && (ply < 2 || ctx.stack[ply - 2].staticEval == MIN_VALUE || ss.staticEval > ctx.stack[ply - 2].staticEval);
 
-		if (moves.size() == 0) {
-			if (info.check)
-				return MIN_VALUE + 1;
-			return 0;
+		Value staticEval = ss.staticEval;
+		bool improving = ss.improving;
+
+		// reverse futility pruning: so far above beta that the opponent is not expected to catch up
+		if (!pvNode && !check && !excluded && depth <= 7 && staticEval - FutilityMargin(depth - improving) >= beta)
+			return beta;
+
+		// razoring: so far below alpha that only captures could help, the quiescence search decides
+		if (!pvNode && !check && !excluded && depth <= 2 && staticEval + RazorMargin(depth) < alpha) {
+			Value eval = QuiesceSearch(ctx, alpha - 1, alpha);
+			if (eval < alpha)
+				return alpha;
+		}
+
+		// null move pruning: if the position is still good enough after passing the turn, a real move
+		// would be too, except in zugzwang, so it is not tried in check, without pieces and twice in a row
+		if (allowNull && !pvNode && !check && !excluded && depth >= 3 && board.HasNonPawnMaterial(board.Turn()) &&
+			staticEval >= beta)
+		{
+			int reduction = 3 + depth / 6;
+
+			ss.move = Move();
+			ss.piece = Piece::Empty;
+			ctx.stack[ply + 1].extensions = ss.extensions;
+			board.PlayNullMove();
+			Value eval = -SearchHelper(ctx, depth - 1 - reduction, ply + 1, -beta, -beta + 1, false);
+			board.UnplayNullMove();
+
+			if (eval >= beta) {
+				if (depth < 12)
+					return beta;
+
+				// deep cutoffs are verified by a reduced search of the node without null moves
+				eval = SearchHelper(ctx, depth - 1 - reduction, ply, beta - 1, beta, false);
+				if (eval >= beta)
+					return beta;
+			}
+		}
+
+		// only 16 bits of the key are verified, MovePicker checks that the move is pseudo legal here
+		Move ttMove = ttentry.key == board.Key() ? ttentry.best : Move();
+
+		PieceToHistory* continuation[2];
+		GetContinuation(ctx, ply, continuation);
+
+		Move counter;
+		if (ply > 0 && ctx.stack[ply - 1].move) {
+			const SearchContext::StackEntry& prev = ctx.stack[ply - 1];
+			counter = ctx.history.counters[PieceIndex(prev.piece)][prev.move.target()];
 		}
 
-		OrderMoves(board, moves);
+		MovePicker picker(board, ttMove, ctx.stack[ply].killers, counter, ctx.history, continuation);
 
 		TTFlag flag = TTFlag::Alpha;
-		Move bestmove = moves[0];
+		Move bestmove;
+		size_t moveCount = 0;
+		MoveList quietsTried, capturesTried;
+
+		for (Move move = picker.next(); move; move = picker.next()) {
+			if (move == ss.excluded || !IsLegal(board, picker.Info(), move))
+				continue;
+
+			bool quiet = board[move.target()] == Piece::Empty && !move.isPromotion() && move.flags() != Move::Flags::EnPassant;
+			bool killer = move == ss.killers[0] || move == ss.killers[1];
 
-		for (const Move& move : moves) {
+			// late move pruning: at low depth the late quiet moves are unlikely to beat a searched one
+			if (quiet && !pvNode && !check && depth <= 3 && moveCount >= LMPLimit(depth, improving))
+				continue;
+
+			// futility pruning: a quiet move has to gain a lot to lift a position this far below alpha
+			if (quiet && !pvNode && !check && depth <= 6 && moveCount && staticEval + FutilityMargin(depth) + 100 <= alpha)
+				continue;
+
+			// a quiet move to a square where it is lost, the margin grows with the depth left to make up for it
+			if (quiet && !pvNode && !check && depth <= 8 && moveCount && SEE(board, move) < -SEEQuietMargin(depth))
+				continue;
+
+			moveCount++;
+
+			Piece piece = board[move.origin()];
+			int historyScore = quiet ? ctx.history.quietScore(board.Turn(), piece, move, continuation) : 0;
+
+			// singular extension: the hash move is extended when a reduced search of the other moves
+			// stays well below its stored value, when they also beat beta the node is cut at once (multi-cut)
+			int extension = 0;
+			if (move == ttMove && !excluded && depth >= 8 && ttentry.depth >= depth - 3 &&
+				ttentry.flag != TTFlag::Alpha && std::abs(ttentry.eval) < MAX_VALUE / 2)
+			{
+				Value singularBeta = ttentry.eval - 2 * depth;
+
+				ss.excluded = move;
+				Value eval = SearchHelper(ctx, (depth - 1) / 2, ply, singularBeta - 1, singularBeta, false);
+				ss.excluded = Move();
+
+				if (eval < singularBeta)
+					extension = 1;
+				else if (singularBeta >= beta)
+					return beta;
+			}
+
+			ss.move = move;
+			ss.piece = piece;
 			board.PlayMove(move);
-			Value eval = -SearchHelper(board, board.Info(), depth - 1, -beta, -alpha);
+			bool givesCheck = bool(board.Checkers());
+
+			if (givesCheck)
+				extension = 1;
+
+			// every extension uses up the budget of the path, so the line stays at most twice the root depth
+			if (ss.extensions >= int(ctx.data.depth))
+				extension = 0;
+
+			int newDepth = depth - 1 + extension;
+			ctx.stack[ply + 1].extensions = ss.extensions + extension;
+
+			// principal variation search: the first move is expected to be the best, the rest
+			// only have to be proven worse with a null window, a move that fails high is searched again
+			Value eval;
+			if (moveCount == 1) {
+				eval = -SearchHelper(ctx, newDepth, ply + 1, -beta, -alpha);
+			}
+			else {
+				// late move reductions: late quiet moves are searched shallower first
+				int reduction = 0;
+				if (quiet && depth >= 3) {
+					// extensions can push depth past the end of the table
+					reduction = reductions[std::min<int>(depth, MAX_DEPTH - 1)][moveCount];
+					reduction -= pvNode + givesCheck + killer;
+					reduction -= historyScore / 8192; // the history can move it by a few plies both ways
+					reduction = std::clamp(reduction, 0, newDepth - 1);
+				}
+
+				eval = -SearchHelper(ctx, newDepth - reduction, ply + 1, -alpha - 1, -alpha);
+				if (eval > alpha && reduction)
+					eval = -SearchHelper(ctx, newDepth, ply + 1, -alpha - 1, -alpha);
+				if (eval > alpha && eval < beta)
+					eval = -SearchHelper(ctx, newDepth, ply + 1, -beta, -alpha);
+			}
 			board.UnplayMove();
 
+			if (ctx.timeout())
+				return 0; // the score of a cut off subtree is not real, it must not reach the tables
+
 			if (eval > alpha) {
 				bestmove = move;
 
 				if (eval >= beta) {
+					UpdateStats(ctx, ply, depth, move, quiet, continuation, quietsTried, capturesTried);
+
 					flag = TTFlag::Beta;
 					alpha = beta;
 					break;
 				}
 				flag = TTFlag::Exact;
 				alpha = eval;
+				UpdatePV(ctx, ply, move);
 			}
+
+			if (quiet)
+				quietsTried.push_back(move);
+			else
+				capturesTried.push_back(move);
 		}
 
-		tpostable.save(board.Key(), depth, alpha, flag, bestmove);
+		if (moveCount == 0) {
+			if (excluded) // the excluded move was the only one
+				return alpha;
+			if (check)
+				return MIN_VALUE + 1;
+			return 0;
+		}
+
+		if (!excluded && !ctx.timeout())
+			tpostable.save(board.Key(), depth, alpha, flag, bestmove);
 		return alpha;
 	}
 
@@ -298,49 +564,78 @@ namespace GGChess
 		roots[bestIdx] = root;
 	}
 
-	RootMove SearchRoot(Board& board, PosInfo& info, RootList& moves, size_t depth, Value alpha, Value beta)
+	static RootMove SearchRoot(SearchContext& ctx, RootList& moves, size_t depth, Value alpha, Value beta)
 	{
-		RootMove best = moves[0];
+		Board& board = ctx.board;
+		RootMove best(moves[0].myMove, alpha); // fail low when no move beats alpha
+		TTFlag flag = TTFlag::Alpha;
 
-		if (info.check)
-			++depth; // extend search to avoid evaluating position when in check
+		ctx.data.windowAlpha = alpha;
+		ctx.data.windowBeta = beta;
+
+		ctx.stack[0].staticEval = board.Checkers() ? MIN_VALUE : Evaluate(board);
+		ctx.stack[0].improving = false;
+		ctx.stack[0].excluded = Move();
+		ctx.stack[0].extensions = 0;
 
-		if (moves.size() == 1)
-			return best;
+		if (board.Checkers())
+			++depth; // extend search to avoid evaluating position when in check
 
 		for (size_t i = 0; i < moves.size(); i++) {
 			PickBest(moves, i); // TODO Test this
 			Move& move = moves[i].myMove;
 
+			ctx.stack[0].move = move;
+			ctx.stack[0].piece = board[move.origin()];
+			ctx.stack[1].extensions = 0;
 			board.PlayMove(move);
-			Value eval = -SearchHelper(board, board.Info(), depth - 1, -beta, -alpha);
-			moves[i].score = eval;
+			Value eval;
+			if (i == 0) {
+				eval = -SearchHelper(ctx, depth - 1, 1, -beta, -alpha);
+			}
+			else {
+				eval = -SearchHelper(ctx, depth - 1, 1, -alpha - 1, -alpha);
+				if (eval > alpha && eval < beta)
+					eval = -SearchHelper(ctx, depth - 1, 1, -beta, -alpha);
+			}
 			board.UnplayMove();
 
-			if (sdata.timeout()) // Search returned is invalid, return current best
+			if (ctx.timeout()) // Search returned is invalid, return current best
 				return best;
 
+			moves[i].score = eval;
+
 			if (eval > alpha) {
 				best = RootMove(move, eval);
-				if (eval > beta) {
+
+				// a fully searched improvement is kept even if the iteration is cut short
+				UpdatePV(ctx, 0, move);
+				ctx.data.best = best;
+				ctx.data.pv.clear();
+				for (size_t j = 0; j < ctx.pvLength[0]; j++)
+					ctx.data.pv.push_back(ctx.pv[0][j]);
+
+				if (eval >= beta) {
 					tpostable.save(board.Key(), depth, eval, TTFlag::Beta, move);
 					return best;
 				}
+				flag = TTFlag::Exact;
+				alpha = eval;
 			}
-			alpha = eval;
-			tpostable.save(board.Key(), depth, eval, TTFlag::Alpha, move);
 		}
-		tpostable.save(board.Key(), depth, alpha, TTFlag::Exact, best.myMove);
+		tpostable.save(board.Key(), depth, alpha, flag, best.myMove);
 		return best;
 	}
 
-	Move Search(Board& board, const Limits& limits) // TODO size_t depth
+	// iterative deepening, helpers start one ply deeper on every second thread so that
+	// the threads spread over different depths and fill the shared table for each other
+	void IterativeDeepening(SearchContext& ctx)
 	{
-		sdata.reset();
-		sdata.allocTime(limits, board);
-		sdata.side = board.Turn();
+		Board& board = ctx.board;
+		SearchData& sdata = ctx.data;
 
-		PosInfo info = board.Info();
+		for (SearchContext::StackEntry& entry : ctx.stack)
+			entry.killers[0] = entry.killers[1] = Move();
 
 		MoveList moves;
 		GetAllMoves(board, board.Info(), moves);
@@ -350,31 +645,53 @@ namespace GGChess
 			roots.push_back(move);
 		}
 
-		sdata.best = SearchRoot(board, info, roots, 1, MIN_VALUE, MAX_VALUE);
+		if (roots.size() == 0) // mate or stalemate, there is nothing to search
+			return;
+
+		sdata.best = SearchRoot(ctx, roots, 1, MIN_VALUE, MAX_VALUE);
 		sdata.depth++;
-		printSearchData(sdata);
+		if (ctx.isMain())
+			printSearchData(ctx);
 
-		for (sdata.depth = 2; !sdata.timeout(); sdata.depth++)
+		if (roots.size() == 1) // the only move is played without searching deeper
+			return;
+
+		for (sdata.depth = 2 + ctx.threadIdx % 2; sdata.depth < MAX_DEPTH - 1 && !ctx.timeout(); sdata.depth++)
 		{
-			//sdata.best = SearchRoot(board, sdata.depth, MIN_VALUE, MAX_VALUE);
-			
-			Value bounds[4][2] = {
-				{ sdata.best.score - 10, sdata.best.score + 10 },
-				{ sdata.best.score - 25, sdata.best.score + 25 },
-				{ sdata.best.score - 50, sdata.best.score + 50 },
-				{ MIN_VALUE, MAX_VALUE }
-			};
-
-			RootMove tempbest;
-			for (size_t i = 0; i < 4; i++) {
-				tempbest = SearchRoot(board, info, roots, sdata.depth, bounds[i][0], bounds[i][1]); // search with aspiration window
-				if (tempbest.score <= bounds[i][0] || tempbest.score >= bounds[i][1])
-					sdata.aspf++;
+			// aspiration window: expect a score near the last one, widen only the side that failed
+			Value
+				delta = ASPIRATION_DELTA,
+				alpha = MIN_VALUE,
+				beta = MAX_VALUE;
+
+			if (sdata.depth >= 4) {
+				alpha = std::max(sdata.best.score - delta, MIN_VALUE);
+				beta = std::min(sdata.best.score + delta, MAX_VALUE);
+			}
+
+			while (true) {
+				RootMove result = SearchRoot(ctx, roots, sdata.depth, alpha, beta);
+
+				if (ctx.timeout())
+					break;
+
+				if (alpha > MIN_VALUE && result.score <= alpha) { // fail low, the best move so far is kept
+					beta = (alpha + beta) / 2;
+					alpha = std::max(result.score - delta, MIN_VALUE);
+				}
+				else if (beta < MAX_VALUE && result.score >= beta) { // fail high, the new move is already stored
+					beta = std::min(result.score + delta, MAX_VALUE);
+				}
+				else {
+					break;
+				}
+
+				sdata.aspf++;
+				delta += delta / 2;
 			}
-			sdata.best = tempbest;
 
-			printSearchData(sdata, true);
+			if (ctx.isMain())
+				printSearchData(ctx, true);
 		}
-		return sdata.best.myMove;
 	}
 }
@@ -1,5 +1,6 @@
 #include "ThreadPool.h"
 
+#include <algorithm>
 #include <iostream>
 
 namespace GGChess
@@ -13,37 +14,63 @@ namespace GGChess
 	TaskPtr TaskQueue::pop() {
 		std::unique_lock<std::mutex> lock(m);
 
-		while (q.empty())
+		while (q.empty() && !stopped)
 			c.wait(lock);
 
+		if (stopped)
+			return nullptr;
+
 		TaskPtr task = q.front();
 		q.pop();
 		return task;
 	}
 
+	void TaskQueue::stop() {
+		std::lock_guard<std::mutex> guard(m);
+		stopped = true;
+		c.notify_all();
+	}
 
-	ThreadPool::ThreadPool() :
-		done(false), work_queue(), threads()
+
+	ThreadPool::ThreadPool(size_t threadCount) :
+		done(false), threads(), work_queue()
 	{
-		const int available = std::thread::hardware_concurrency();
 		try {
-			for (int i = 0; i < available / 2; i++)
+			for (size_t i = 0; i < std::max<size_t>(threadCount, 1); i++)
 				threads.push_back(std::thread(&ThreadPool::worker_thread, this));
 		}
 		catch (...) {
 			done = true;
+			work_queue.stop();
+			for (std::thread& thread : threads)
+				thread.join();
 			throw;
 		}
 	}
 
+	// wakes the workers blocked in pop and joins them, destroying a joinable thread would terminate
 	ThreadPool::~ThreadPool() {
 		done = true;
+		work_queue.stop();
+
+		for (std::thread& thread : threads)
+			thread.join();
+	}
+
+	size_t ThreadPool::size() const {
+		return threads.size();
+	}
+
+	size_t ThreadPool::DefaultSize() {
+		return std::max(std::thread::hardware_concurrency() / 2, 1u);
 	}
 
 	void ThreadPool::worker_thread()
 	{
 		while (!done) {
 			TaskPtr taskPtr = work_queue.pop();
+			if (!taskPtr)
+				break;
 			(*taskPtr)();
 		}
 	}
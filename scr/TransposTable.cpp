@@ -1,23 +1,92 @@
 #include "TransposTable.h"
 
 #include <stdlib.h>
+#include <cstring>
 #include <algorithm>
+#include <fstream>
+#include <thread>
+#include <vector>
 #include <xmmintrin.h>
 
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
 namespace GGChess
 {
 	TransposTable tpostable;
 
+	// tables come straight from the OS, page aligned and zero filled as they are first touched,
+	// on Linux they are backed by transparent huge pages where the kernel allows it
+	static void* LargeAlloc(size_t size)
+	{
+#ifdef _WIN32
+		return VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+		void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (ptr == MAP_FAILED)
+			return nullptr;
+#ifdef MADV_HUGEPAGE
+		madvise(ptr, size, MADV_HUGEPAGE);
+#endif
+		return ptr;
+#endif
+	}
+
+	static void LargeFree(void* ptr, size_t size)
+	{
+		if (!ptr)
+			return;
+#ifdef _WIN32
+		VirtualFree(ptr, 0, MEM_RELEASE);
+#else
+		munmap(ptr, size);
+#endif
+	}
+
+	// zeroes the table in equal slices, one per thread
+	static void ParallelClear(void* table, size_t size, size_t threadCount)
+	{
+		if (!table)
+			return;
+
+		threadCount = std::max<size_t>(threadCount, 1);
+		size_t slice = size / threadCount;
+
+		std::vector<std::thread> threads;
+		for (size_t i = 0; i < threadCount; i++) {
+			size_t
+				begin = i * slice,
+				end = i + 1 == threadCount ? size : begin + slice;
+
+			threads.emplace_back([table, begin, end]() {
+				std::memset((char*)table + begin, 0, end - begin);
+			});
+		}
+
+		for (std::thread& thread : threads)
+			thread.join();
+	}
+
 	TransposTable::TransposTable() :
-		tt(nullptr), ptt(nullptr), ett(nullptr)
+		tt(nullptr), tt_size(0), tt_bytes(0), generation(0),
+		ptt(nullptr), ptt_size(0), ptt_bytes(0),
+		ett(nullptr), ett_size(0), ett_bytes(0)
 	{
-		resize(0x4000000);
-		ptt_resize(0x1000000);
-		ett_resize(0x2000000);
+		resize(TT_DEFAULT_MB * 1024 * 1024);
+		ptt_resize(PTT_DEFAULT_MB * 1024 * 1024);
+		ett_resize(ETT_DEFAULT_MB * 1024 * 1024);
 	}
 
 	TransposTable::TransposTable(size_t ttSize, size_t pttSize, size_t ettSize) :
-		tt(nullptr), ptt(nullptr), ett(nullptr)
+		tt(nullptr), tt_size(0), tt_bytes(0), generation(0),
+		ptt(nullptr), ptt_size(0), ptt_bytes(0),
+		ett(nullptr), ett_size(0), ett_bytes(0)
 	{
 		resize(ttSize);
 		ptt_resize(pttSize);
@@ -26,21 +95,207 @@ namespace GGChess
 
 	TransposTable::~TransposTable()
 	{
-		if (tt) free(tt);
-		if (ptt) free(ptt);
-		if (ett) free(ett);
+		LargeFree(tt, tt_bytes);
+		LargeFree(ptt, ptt_bytes);
+		LargeFree(ett, ett_bytes);
+	}
+
+	void TransposTable::clear(size_t threadCount)
+	{
+		ParallelClear(tt, tt_bytes, threadCount);
+		ParallelClear(ptt, ptt_bytes, threadCount);
+		ParallelClear(ett, ett_bytes, threadCount);
+		generation = 0;
+	}
+
+	static const char SNAPSHOT_MAGIC[8] = { 'G', 'G', 'C', 'H', 'E', 'S', 'S', 'T' };
+	static const size_t SNAPSHOT_PAGE = 4096;
+
+	static inline uint64_t PageAlign(uint64_t bytes) {
+		return (bytes + SNAPSHOT_PAGE - 1) & ~uint64_t(SNAPSHOT_PAGE - 1);
+	}
+
+	// a table of the snapshot has to be one resize_tt could have made
+	static bool ValidTableSize(uint64_t bytes, size_t entrySize)
+	{
+		if (bytes % entrySize)
+			return false;
+
+		uint64_t count = bytes / entrySize;
+		return count == 0 || (count >= 2 && !(count & (count - 1)));
+	}
+
+	// writes the bytes and pads them with zeros to the next page
+	static bool WriteSection(std::ofstream& file, const void* data, uint64_t bytes)
+	{
+		static const char zeros[SNAPSHOT_PAGE] = {};
+
+		if (bytes)
+			file.write((const char*)data, bytes);
+		file.write(zeros, PageAlign(bytes) - bytes);
+		return bool(file);
+	}
+
+	static void* ReadSection(std::ifstream& file, uint64_t offset, uint64_t bytes)
+	{
+		void* table = LargeAlloc(bytes);
+		if (!table)
+			return nullptr;
+
+		if (!file.seekg(offset) || !file.read((char*)table, bytes)) {
+			LargeFree(table, bytes);
+			return nullptr;
+		}
+		return table;
+	}
+
+	bool TransposTable::saveSnapshot(const std::string& path) const
+	{
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		if (!file)
+			return false;
+
+		SnapshotHeader header = {};
+		std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+		header.version = SNAPSHOT_VERSION;
+		header.clusterSize = sizeof(TTCluster);
+		header.simpleEntrySize = sizeof(SimpleTTEntry);
+		header.generation = generation;
+		header.zobristSeed = ZOBRIST_SEED;
+		header.ttBytes = tt_bytes;
+		header.pttBytes = ptt_bytes;
+		header.ettBytes = ett_bytes;
+
+		return WriteSection(file, &header, sizeof(header)) &&
+			WriteSection(file, tt, tt_bytes) &&
+			WriteSection(file, ptt, ptt_bytes) &&
+			WriteSection(file, ett, ett_bytes);
+	}
+
+	bool TransposTable::loadSnapshot(const std::string& path)
+	{
+		std::ifstream file(path, std::ios::binary);
+		SnapshotHeader header;
+		if (!file.read((char*)&header, sizeof(header)))
+			return false;
+
+		if (std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) ||
+			header.version != SNAPSHOT_VERSION ||
+			header.clusterSize != sizeof(TTCluster) ||
+			header.simpleEntrySize != sizeof(SimpleTTEntry) ||
+			header.zobristSeed != ZOBRIST_SEED ||
+			!ValidTableSize(header.ttBytes, sizeof(TTCluster)) ||
+			!ValidTableSize(header.pttBytes, sizeof(SimpleTTEntry)) ||
+			!ValidTableSize(header.ettBytes, sizeof(SimpleTTEntry)))
+			return false;
+
+		const uint64_t bytes[3] = { header.ttBytes, header.pttBytes, header.ettBytes };
+		uint64_t offsets[3];
+		offsets[0] = SNAPSHOT_PAGE;
+		offsets[1] = offsets[0] + PageAlign(bytes[0]);
+		offsets[2] = offsets[1] + PageAlign(bytes[1]);
+
+		uint64_t fileBytes = offsets[2] + bytes[2];
+		if (!file.seekg(0, std::ios::end) || uint64_t(file.tellg()) < fileBytes)
+			return false;
+
+		void* tables[3] = {};
+		bool loaded = false;
+
+#ifndef _WIN32
+		// private mapping: pages are read from the file when first probed and copied when
+		// first written, the file itself never changes; every table lies on its own pages,
+		// so LargeFree releases it from the mapping like any other table
+		int fd = open(path.c_str(), O_RDONLY);
+		if (fd >= 0) {
+			void* map = mmap(nullptr, fileBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+			close(fd);
+
+			if (map != MAP_FAILED) {
+				munmap(map, SNAPSHOT_PAGE); // the header
+				for (size_t i = 0; i < 3; i++)
+					tables[i] = bytes[i] ? (char*)map + offsets[i] : nullptr;
+				loaded = true;
+			}
+		}
+#endif
+
+		if (!loaded) {
+			file.clear();
+			for (size_t i = 0; i < 3; i++) {
+				if (bytes[i] && !(tables[i] = ReadSection(file, offsets[i], bytes[i]))) {
+					for (size_t j = 0; j < i; j++)
+						LargeFree(tables[j], bytes[j]);
+					return false;
+				}
+			}
+		}
+
+		LargeFree(tt, tt_bytes);
+		LargeFree(ptt, ptt_bytes);
+		LargeFree(ett, ett_bytes);
+
+		tt = (TTCluster*)tables[0];
+		tt_bytes = bytes[0];
+		tt_size = tt_bytes ? tt_bytes / sizeof(TTCluster) - 1 : 0;
+
+		ptt = (SimpleTTEntry*)tables[1];
+		ptt_bytes = bytes[1];
+		ptt_size = ptt_bytes ? ptt_bytes / sizeof(SimpleTTEntry) - 1 : 0;
+
+		ett = (SimpleTTEntry*)tables[2];
+		ett_bytes = bytes[2];
+		ett_size = ett_bytes ? ett_bytes / sizeof(SimpleTTEntry) - 1 : 0;
+
+		generation = header.generation;
+		return true;
+	}
+
+	// every search the entry missed counts as much as 8 plies of depth
+	static inline int ReplaceScore(const TTSlot& slot, uint8_t generation) {
+		return slot.depth - 8 * (uint8_t(generation - slot.generation()) >> 2);
 	}
 
 	void TransposTable::resize(size_t size) {
-		tt_size = resize_tt((void**)(&tt), sizeof(TTEntry), size);
+		tt_size = resize_tt((void**)(&tt), tt_bytes, sizeof(TTCluster), size);
+	}
+
+	inline TTCluster& TransposTable::cluster(ZobristKey key) {
+		return tt[key & tt_size];
+	}
+
+	void TransposTable::newSearch() {
+		generation += 4;
 	}
 
 	bool TransposTable::probe(ZobristKey key, uint8_t depth, Value alpha, Value beta, TTEntry& entry)
 	{
-		if (tt_size) {
-			entry = tt[key & tt_size];
+		entry = TTEntry();
+		if (!tt)
+			return false;
+
+		uint16_t key16 = uint16_t(key >> 48);
 
-			if (entry.key == key && entry.depth >= depth) {
+		for (std::atomic<uint64_t>& data : cluster(key).slots) {
+			uint64_t loaded = data.load(std::memory_order_relaxed);
+			TTSlot slot = TTSlot::unpack(loaded);
+			if (slot.key != key16 || !slot.depth)
+				continue;
+
+			// still in use, keep it young; only if the slot is unchanged, a racing save wins
+			if (slot.generation() != generation) {
+				TTSlot young = slot;
+				young.genFlag = uint8_t(generation | uint8_t(slot.flag()));
+				data.compare_exchange_weak(loaded, young.pack(), std::memory_order_relaxed);
+			}
+
+			entry.key = key;
+			entry.eval = slot.eval;
+			entry.best = slot.best;
+			entry.depth = slot.depth;
+			entry.flag = slot.flag();
+
+			if (entry.depth >= depth) {
 				switch (entry.flag) {
 				case TTFlag::Exact:
 					return true;
@@ -52,71 +307,98 @@ namespace GGChess
 					return true;
 				}
 			}
+			return false;
 		}
 		return false;
 	}
 
 	void TransposTable::save(ZobristKey key, uint8_t depth, Value eval, TTFlag flag, Move best)
 	{
-		if (!tt_size) return;
+		if (!tt) return;
 
-		TTEntry& entry = tt[key & tt_size];
+		uint16_t key16 = uint16_t(key >> 48);
+		TTCluster& entries = cluster(key);
 
-		if (key == entry.key && entry.depth > depth)
-			return;
+		std::atomic<uint64_t>* target = &entries.slots[0];
+		TTSlot replace = TTSlot::unpack(target->load(std::memory_order_relaxed));
 
-		entry.key = key;
-		entry.depth = depth;
-		entry.eval = eval;
-		entry.flag = flag;
-		entry.best = best;
+		// the same position if it is stored, else the slot worth least: shallow and from an old search
+		for (std::atomic<uint64_t>& data : entries.slots) {
+			TTSlot slot = TTSlot::unpack(data.load(std::memory_order_relaxed));
+
+			if (slot.key == key16 && slot.depth) {
+				target = &data;
+				replace = slot;
+				break;
+			}
+
+			if (ReplaceScore(slot, generation) < ReplaceScore(replace, generation)) {
+				target = &data;
+				replace = slot;
+			}
+		}
+
+		if (replace.key == key16 && replace.depth) {
+			if (!best)
+				best = replace.best; // a fail low has no move, keep the known one
+
+			if (replace.depth > depth && replace.generation() == generation)
+				return;
+		}
+
+		TTSlot slot = { key16, best, int16_t(eval), depth, uint8_t(generation | uint8_t(flag)) };
+		target->store(slot.pack(), std::memory_order_relaxed);
 	}
 
 	void TransposTable::prefetch(ZobristKey key) {
-		_mm_prefetch((char*)&tt[key & tt_size], _MM_HINT_NTA);
+		if (tt)
+			_mm_prefetch((char*)&cluster(key), _MM_HINT_NTA);
 	}
 
 	void TransposTable::ptt_resize(size_t size) {
-		tt_size = resize_tt((void**)(&ptt), sizeof(SimpleTTEntry), size);
+		ptt_size = resize_tt((void**)(&ptt), ptt_bytes, sizeof(SimpleTTEntry), size);
 	}
 
-	bool TransposTable::ptt_probe(ZobristKey key, SimpleTTEntry& entry) {
-		if (!ptt_size)
+	// a torn entry cannot exist, a probe sees one whole save or another and the key check
+	// rejects the entries of other positions
+	static inline bool SimpleProbe(const SimpleTTEntry& entry, ZobristKey key, Value& eval)
+	{
+		uint64_t data = entry.data.load(std::memory_order_relaxed);
+		if ((data ^ key) >> 16)
 			return false;
 
-		entry = ptt[key & ptt_size];
+		eval = int16_t(uint16_t(data));
+		return true;
+	}
 
-		if (entry.key != key)
+	static inline void SimpleSave(SimpleTTEntry& entry, ZobristKey key, Value eval) {
+		entry.data.store((key & ~uint64_t(0xFFFF)) | uint16_t(int16_t(eval)), std::memory_order_relaxed);
+	}
+
+	bool TransposTable::ptt_probe(ZobristKey key, Value& eval) {
+		if (!ptt_size)
 			return false;
 
-		return true;
+		return SimpleProbe(ptt[key & ptt_size], key, eval);
 	}
 
 	void TransposTable::ptt_save(ZobristKey key, Value eval) {
 		if (!ptt_size)
 			return;
 
-		SimpleTTEntry& entry = ptt[key & ptt_size];
-
-		entry.key = key;
-		entry.eval = eval;
+		SimpleSave(ptt[key & ptt_size], key, eval);
 	}
 
 	void TransposTable::ett_resize(size_t size) {
-		ett_size = resize_tt((void**)(&ett), sizeof(SimpleTTEntry), size);
+		ett_size = resize_tt((void**)(&ett), ett_bytes, sizeof(SimpleTTEntry), size);
 	}
 
-	bool TransposTable::ett_probe(ZobristKey key, SimpleTTEntry& entry)
+	bool TransposTable::ett_probe(ZobristKey key, Value& eval)
 	{
 		if (!ett_size)
 			return false;
 
-		entry = ett[key & ett_size];
-
-		if (entry.key == key)
-			return true;
-
-		return false;
+		return SimpleProbe(ett[key & ett_size], key, eval);
 	}
 
 	void TransposTable::ett_save(ZobristKey key, Value eval)
@@ -124,32 +406,29 @@ namespace GGChess
 		if (!ett_size)
 			return;
 
-		SimpleTTEntry& entry = ett[key & ett_size];
-
-		entry.key = key;
-		entry.eval = eval;
+		SimpleSave(ett[key & ett_size], key, eval);
 	}
 
-	size_t TransposTable::resize_tt(void** table, size_t entry_size, size_t size)
+	// size in bytes is rounded down to a power of two entries, returns the index mask,
+	// a size below two entries leaves the table disabled
+	size_t TransposTable::resize_tt(void** table, size_t& bytes, size_t entry_size, size_t size)
 	{
-		if (table)
-			free(*table);
+		LargeFree(*table, bytes);
+		*table = nullptr;
+		bytes = 0;
 
-		if (size & (size - 1)) {
-			size--;
-			for (int i = 1; i < 32; i = i * 2)
-				size |= size >> i;
-			size++;
-			size >>= 1;
-		}
+		size_t count = 1;
+		while (count * 2 * entry_size <= size)
+			count *= 2;
 
-		if (size < 16) {
+		if (count < 2)
 			return 0;
-		}
 
-		size_t table_size = (size / entry_size) - 1;
-		*table = malloc(size);
+		*table = LargeAlloc(count * entry_size);
+		if (!*table)
+			return 0;
 
-		return table_size;
+		bytes = count * entry_size;
+		return count - 1;
 	}
 }
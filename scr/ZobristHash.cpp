@@ -22,7 +22,7 @@ namespace GGChess
 		if (initFlag)
 			return;
 
-		RandGen rgen(1070372);
+		RandGen rgen(ZOBRIST_SEED);
 
 		for (size_t side = 0; side < 2; side++)
 			for (size_t pIdx = 0; pIdx < PIECE_COUNT; pIdx++)
@@ -58,13 +58,18 @@ namespace GGChess
 	}
 
 	void ZobristHash::enPassant(Square square) {
-		currentKey ^= ep[(size_t)square];
+		if (square != Square::InvalidSquare)
+			currentKey ^= ep[fileof(square)];
 	}
 
 	void ZobristHash::flipSide() {
 		currentKey ^= turn;
 	}
 
+	void ZobristHash::restore(ZobristKey key) {
+		currentKey = key;
+	}
+
 	void ZobristHash::calculate(const Board& board)
 	{
 		currentKey = 0;